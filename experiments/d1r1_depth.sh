@@ -0,0 +1,56 @@
+#!/bin/bash
+# Compares idx_d1r1 with U and R built for the blocks of depth 1, 2 and 3:
+# space of the WTs and search time per expanded WT node, for term queries
+# and for phrase queries (-P), whose frequencies are exact up to the depth.
+# usage: ./d1r1_depth.sh [build dir]
+CUR_DIR=`pwd`
+MY_DIR="$( cd "$( dirname "$0" )" && pwd )" # gets the directory where the script is located in
+cd "${MY_DIR}"
+MY_DIR=`pwd`
+SURF_PATH=/scratch/VR0052/ESA2014/surf
+
+BUILD=${1:-$SURF_PATH/build}
+
+COLLECTIONS="$SURF_PATH/collections/gov2 $SURF_PATH/collections/cluewebB"
+EXP_DIR="$SURF_PATH/experiments"
+QUERY_LOGS="trec2005-efficiency-1000 trec2006-efficiency-1000"
+PORT=12346
+
+INDEXES="IDX_D1R1 IDX_D1R1_D2 IDX_D1R1_D3"
+
+# mem_info prints the sizes of CSA;WTD;DF;WTR;DOCPERM;TERMSTATS;TFBOUNDS;TOPKLISTS;RANGETABLE and the total in bytes
+echo "collection;index;csa;wtd;df;wtr;docperm;termstats;tfbounds;topklists;rangetable;total" > $EXP_DIR/d1r1_depth_space.csv
+echo "qryid;collection;ranker;index;qrymode;k;qrylen;res_size;qry_time;search_time;nodes_evaluated;nodes_total;postings_evaluated;postings_total;client_time" > $EXP_DIR/d1r1_depth_profile.csv
+head -n 1 $EXP_DIR/d1r1_depth_profile.csv > $EXP_DIR/d1r1_depth_phrase_profile.csv
+
+for col in $COLLECTIONS
+do
+    for idx in $INDEXES
+    do
+        $BUILD/surf_index-$idx -c $col -m | tail -n 1 | \
+            awk -v c=`basename $col` -v i=$idx '{print c";"i";"$0}' >> $EXP_DIR/d1r1_depth_space.csv
+        $BUILD/surf_daemon-$idx -c $col -p $PORT &
+        for qry in $QUERY_LOGS
+        do
+            for k in 10 100 1000
+            do
+                $BUILD/surf_query -h localhost:$PORT -q $SURF_PATH/queries/$qry.qry -k $k -r 1 -p >> $EXP_DIR/d1r1_depth_profile.csv
+                $BUILD/surf_query -h localhost:$PORT -q $SURF_PATH/queries/$qry.qry -k $k -r 1 -a -p >> $EXP_DIR/d1r1_depth_profile.csv
+                $BUILD/surf_query -h localhost:$PORT -q $SURF_PATH/queries/$qry.qry -k $k -r 1 -P 10 -p >> $EXP_DIR/d1r1_depth_phrase_profile.csv
+            done
+        done
+        # shut down daemon
+        $BUILD/surf_query -h localhost:$PORT -q $SURF_PATH/queries/wiki.q -k 1 -s > /dev/null
+    done
+done
+
+# search time per expanded node (in microseconds) for each index and k
+for prof in d1r1_depth_profile d1r1_depth_phrase_profile
+do
+    tail -n +2 $EXP_DIR/$prof.csv | \
+        awk -F';' '$11 > 0 {t[$2";"$4";"$6]+=$10; n[$2";"$4";"$6]+=$11}
+                   END {print "collection;index;k;us_per_node";
+                        for (x in t) print x";"t[x]/n[x]}' > $EXP_DIR/${prof/profile/time_per_node}.csv
+done
+
+cd "${CUR_DIR}"
@@ -0,0 +1,57 @@
+#!/bin/bash
+# Compares the query times of two builds (e.g. before and after a change)
+# on the TREC 2005/2006 efficiency logs.
+# usage: ./query_times.sh <build dir before> <build dir after>
+# Writes the time of every query to query_times.csv and the mean and 95th
+# percentile per build to query_times_summary.csv.
+# For the search states of idx_d::search, build "before" from the parent of
+# the commit which added include/surf/search_arena.hpp, e.g.
+#   git worktree add ../surf_before $(git log --format=%h --diff-filter=A -- include/surf/search_arena.hpp)~1
+CUR_DIR=`pwd`
+MY_DIR="$( cd "$( dirname "$0" )" && pwd )" # gets the directory where the script is located in
+cd "${MY_DIR}"
+MY_DIR=`pwd`
+#SURF_PATH=$MY_DIR/..
+SURF_PATH=/scratch/VR0052/ESA2014/surf
+
+BUILD_BEFORE=${1:-$SURF_PATH/build_before}
+BUILD_AFTER=${2:-$SURF_PATH/build}
+
+COLLECTIONS="$SURF_PATH/collections/gov2"
+EXP_DIR="$SURF_PATH/experiments"
+QUERY_LOGS="trec2005-efficiency-1000 trec2006-efficiency-1000"
+
+INDEXES="IDX_D"
+
+echo "build;collection;index;queries;k;id;num_terms;time_ms" > $EXP_DIR/query_times.csv
+
+for col in $COLLECTIONS
+do
+    for idx in $INDEXES
+    do
+        for build in $BUILD_BEFORE $BUILD_AFTER
+        do
+            for qry in $QUERY_LOGS
+            do
+                for k in 10 100 1000
+                do
+                    rm -f $col/results/surf-timings-$idx-k$k-*.csv
+                    $build/surf_search-$idx -c $col -q $SURF_PATH/queries/$qry.qry -k $k > /dev/null
+                    tail -n +2 $col/results/surf-timings-$idx-k$k-*.csv | \
+                        awk -F';' -v b=`basename $build` -v c=`basename $col` -v q=$qry \
+                            '{print b";"c";"$2";"q";"$3";"$1";"$4";"$5}' >> $EXP_DIR/query_times.csv
+                done
+            done
+        done
+    done
+done
+
+# mean and 95th percentile of the query time per build, log and k
+echo "build;collection;index;queries;k;mean_ms;p95_ms" > $EXP_DIR/query_times_summary.csv
+tail -n +2 $EXP_DIR/query_times.csv | sort -t';' -k1,1 -k2,2 -k3,3 -k4,4 -k5,5n -k8,8g | \
+    awk -F';' '{g=$1";"$2";"$3";"$4";"$5; t[g,++n[g]]=$8; s[g]+=$8}
+               END {for (g in n) print g";"s[g]/n[g]";"t[g,int(0.95*(n[g]-1))+1]}' | \
+    sort >> $EXP_DIR/query_times_summary.csv
+cat $EXP_DIR/query_times_summary.csv
+
+cd "${CUR_DIR}"
@@ -0,0 +1,48 @@
+#!/bin/bash
+# Compares space and query times of the indexes over a wavelet tree (wt_int)
+# and over a wavelet matrix (wm_int) for the document array.
+# The wm_int variants are not in config/ until this comparison has results.
+# To run it, create IDX-D-WM, IDX-DR-WM and IDX-D1R1-WM.config as copies of
+# the wt_int configs with NAME=<name>_WM and the document array (WTD_TYPE,
+# WTU_TYPE for IDX-D1R1) replaced by
+#   sdsl::wm_int<sdsl::bit_vector, sdsl::rank_support_v5<>, sdsl::select_support_scan<1>, sdsl::select_support_scan<0>>
+# usage: ./wt_layouts.sh [build dir]
+CUR_DIR=`pwd`
+MY_DIR="$( cd "$( dirname "$0" )" && pwd )" # gets the directory where the script is located in
+cd "${MY_DIR}"
+MY_DIR=`pwd`
+SURF_PATH=/scratch/VR0052/ESA2014/surf
+
+BUILD=${1:-$SURF_PATH/build}
+
+COLLECTIONS="$SURF_PATH/collections/gov2"
+EXP_DIR="$SURF_PATH/experiments"
+QUERY_LOGS="trec2005-efficiency-1000 trec2006-efficiency-1000"
+
+INDEXES="IDX_D IDX_D_WM IDX_DR IDX_DR_WM IDX_D1R1 IDX_D1R1_WM"
+
+# mem_info prints the sizes of CSA;WTD;DF;WTR;DOCPERM;TERMSTATS;TFBOUNDS;TOPKLISTS;RANGETABLE and the total in bytes
+echo "collection;index;csa;wtd;df;wtr;docperm;termstats;tfbounds;topklists;rangetable;total" > $EXP_DIR/wt_layouts_space.csv
+echo "collection;index;queries;k;id;num_terms;time_ms" > $EXP_DIR/wt_layouts_time.csv
+
+for col in $COLLECTIONS
+do
+    for idx in $INDEXES
+    do
+        $BUILD/surf_index-$idx -c $col -m | tail -n 1 | \
+            awk -v c=`basename $col` -v i=$idx '{print c";"i";"$0}' >> $EXP_DIR/wt_layouts_space.csv
+        for qry in $QUERY_LOGS
+        do
+            for k in 10 100 1000
+            do
+                rm -f $col/results/surf-timings-$idx-k$k-*.csv
+                $BUILD/surf_search-$idx -c $col -q $SURF_PATH/queries/$qry.qry -k $k > /dev/null
+                tail -n +2 $col/results/surf-timings-$idx-k$k-*.csv | \
+                    awk -F';' -v c=`basename $col` -v q=$qry \
+                        '{print c";"$2";"q";"$3";"$1";"$4";"$5}' >> $EXP_DIR/wt_layouts_time.csv
+            done
+        done
+    done
+done
+
+cd "${CUR_DIR}"
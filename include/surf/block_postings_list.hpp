@@ -98,6 +98,7 @@ class plist_iterator
         size_t size() const { return m_plist_ptr->size(); }
         size_t remaining() const { return size() - m_cur_pos; }
         size_t offset() const { return m_cur_pos; }
+        size_t block_id() const { return m_cur_pos / t_block_size; }
     private:
         void access_and_decode_cur_pos() const;
     private:
@@ -134,11 +135,15 @@ private: // actual data
 	double m_list_maximuim = std::numeric_limits<double>::lowest();
 	double m_max_doc_weight = std::numeric_limits<double>::lowest();
 	std::vector<block_data> m_block_data;
+	std::vector<double> m_block_max_score;      // maximum score in each block
+	std::vector<double> m_block_max_doc_weight; // maximum doc weight in each block
     pfor_data_type m_docid_data;
     pfor_data_type m_freq_data;
 public: // default 
     block_postings_list() {
     	m_block_data.resize(1);
+    	m_block_max_score.resize(1,std::numeric_limits<double>::lowest());
+    	m_block_max_doc_weight.resize(1,std::numeric_limits<double>::lowest());
     }
     block_postings_list(const block_postings_list& pl) = default;
     block_postings_list(block_postings_list&& pl) = default;
@@ -239,6 +244,8 @@ private: // functions used during construction
 	    size_t num_blocks = ids.size() / t_block_size;
 	    if (ids.size() % t_block_size != 0) num_blocks++;
 	    m_block_data.resize(num_blocks);
+	    m_block_max_score.assign(num_blocks,std::numeric_limits<double>::lowest());
+	    m_block_max_doc_weight.assign(num_blocks,std::numeric_limits<double>::lowest());
 	    size_t j = 0;
 	    for (size_t i=t_block_size-1; i<ids.size(); i+=t_block_size) {
 	        m_block_data[j++].max_block_id = ids[i];
@@ -260,6 +267,9 @@ private: // functions used during construction
 	        double score = ranker.calculate_docscore(1.0f,f_dt,f_t,F_t,W_d,true);
 	        m_list_maximuim = std::max(m_list_maximuim,score);
 	        m_max_doc_weight = std::max(m_max_doc_weight,doc_weight);
+	        size_t b = l / t_block_size;
+	        m_block_max_score[b] = std::max(m_block_max_score[b],score);
+	        m_block_max_doc_weight[b] = std::max(m_block_max_doc_weight[b],doc_weight);
 	    }
 	}
 	void compress_postings_data(const sdsl::int_vector<32>& ids,
@@ -273,7 +283,7 @@ private: // functions used during construction
         for(size_t i=0;i<freqs.size();i++) freqs[i]--;
 
 	    // encode ids and freqs using pfor
-	    static comp_codec c;
+	    static thread_local comp_codec c;
 	    m_docid_data.resize(2 * ids.size() + 1024);
 	    uint32_t* id_out = m_docid_data.data();
 	    m_freq_data.resize(2 * freqs.size() + 1024);
@@ -337,7 +347,7 @@ public: // functions used during processing
 	    size_t rec_ids;
 	    size_t rec_freqs;
 		if(block_size == t_block_size) { // PFor
-			static comp_codec c;
+			static thread_local comp_codec c;
 			c.decodeBlock(id_start,id_data.data(),rec_ids);
 			c.decodeBlock(freq_start,freq_data.data(),rec_freqs);
 		} else { // vbyte
@@ -375,6 +385,12 @@ public: // functions used during processing
 	uint32_t block_rep(size_t bid) const {
 		return m_block_data[bid].max_block_id;
 	}
+	double block_max_score(size_t bid) const {
+		return m_block_max_score[bid];
+	}
+	double block_max_doc_weight(size_t bid) const {
+		return m_block_max_doc_weight[bid];
+	}
 	size_type num_blocks() const {
 		return m_block_data.size();
 	}
@@ -433,6 +449,15 @@ public: // functions used during processing
 	    written_bytes += sdsl::write_member(m_list_maximuim,out,child,"list max score");
 	    written_bytes += sdsl::write_member(m_max_doc_weight,out,child,"max doc weight");
 
+	    if(m_size > t_block_size) { // the maxima of a single block are the list maxima
+	    	auto* bmchild = sdsl::structure_tree::add_child(child, "block max","block max");
+	    	size_type bm_bytes = m_block_data.size()*sizeof(double);
+	    	out.write((const char*)m_block_max_score.data(), bm_bytes);
+	    	out.write((const char*)m_block_max_doc_weight.data(), bm_bytes);
+	    	written_bytes += 2*bm_bytes;
+	    	sdsl::structure_tree::add_size(bmchild, 2*bm_bytes);
+	    }
+
 	    sdsl::structure_tree::add_size(child, written_bytes);
 	    return written_bytes;
 	}
@@ -462,6 +487,16 @@ public: // functions used during processing
 
 	    read_member(m_list_maximuim,in);
 	    read_member(m_max_doc_weight,in);
+
+	    m_block_max_score.resize(m_block_data.size());
+	    m_block_max_doc_weight.resize(m_block_data.size());
+	    if(m_size > t_block_size) {
+	    	in.read((char*)m_block_max_score.data(),m_block_data.size()*sizeof(double));
+	    	in.read((char*)m_block_max_doc_weight.data(),m_block_data.size()*sizeof(double));
+	    } else {
+	    	m_block_max_score[0] = m_list_maximuim;
+	    	m_block_max_doc_weight[0] = m_max_doc_weight;
+	    }
 	}
 };
 
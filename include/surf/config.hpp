@@ -24,7 +24,6 @@ const std::string KEY_SADADF = "sadadf";
 const std::string KEY_WTD = "wtd";
 const std::string KEY_C = "C";
 const std::string KEY_WTC = "wtc";
-const std::string KEY_TMPCST = "tempcst";
 const std::string KEY_TMPDUP = "tmpdup";
 const std::string KEY_WTDUP  = "wtdup";
 const std::string KEY_WTDUP2  = "wtdup2";
@@ -40,13 +39,22 @@ const std::string KEY_COLLEN  = "collen";
 const std::string KEY_DOCBORDER = "docborder";
 const std::string KEY_DOC_LENGTHS = "doclengths";
 const std::string KEY_INVFILE_TERM_RANGES = "invfile_term_ranges";
-const std::string KEY_INVFILE_PLISTS = "invfile_postings_lists";
+const std::string KEY_INVFILE_PLISTS = "invfile_postings_lists_bm"; // with block maxima
 const std::string KEY_INVFILE_DOCPERM = "invfile_docperm";
 const std::string KEY_INVFILE_IDOCPERM = "invfile_inv_docperm";
 const std::string KEY_F_T = "Ft";
 const std::string KEY_H = "H";
 const std::string KEY_CSA = "csa";
 const std::string KEY_MAXTF = "maxtf";
+const std::string KEY_TERMSTATS = "termstats";
+const std::string KEY_TERMSTATS_DR = "termstats-dr";
+const std::string KEY_TERMSTATS_D1R1 = "termstats-d1r1";
+const std::string KEY_TERMSTATS_D1R1MTF = "termstats-d1r1mtf";
+const std::string KEY_TFBOUNDS = "tfbounds";
+const std::string KEY_RANGETABLE = "rangetable";
+const std::string KEY_TOPKLISTS = "topklists";
+const std::string KEY_TOPKLISTS_INVFILE = "topklists-invfile";
+const std::string KEY_DIRECTCOST = "directcost";
 
 std::vector<std::string> storage_keys = {KEY_DOCCNT,
 										 KEY_DARRAY,
@@ -55,7 +63,6 @@ std::vector<std::string> storage_keys = {KEY_DOCCNT,
 										 KEY_WTD,
 										 KEY_C,
 										 KEY_WTC,
-										 KEY_TMPCST,
 										 KEY_TMPDUP,
 										 KEY_DUP,
 										 KEY_DUP2,
@@ -2,6 +2,7 @@
 #define SURF_CONSTRUCT_DUP2_HPP
 
 #include <sdsl/int_vector.hpp>
+#include "surf/lcp_intervals.hpp"
 
 namespace surf{
 
@@ -33,19 +34,12 @@ void construct_dup2(sdsl::cache_config& cc)
         cout<<".........load df"<<endl;
         t_df df;
         load_from_cache(df, surf::KEY_SADADF, cc, true);
-        cout<<".........load cst"<<endl;
-        using cst_type =  typename t_df::cst_type;
-        cst_type cst;
-        load_from_file(cst, cache_file_name<cst_type>(surf::KEY_TMPCST, cc));
-        cout<<".........cst.size()="<<cst.size()<<endl;
-        auto root = cst.root();
-        auto left_most_leaf = cst.select_leaf(1);
+        int_vector_buffer<> lcp(cache_file_name(conf::KEY_LCP, cc));
+        cout<<".........lcp.size()="<<lcp.size()<<endl;
         uint64_t next_idx = 0;
-        for (auto& v : cst.children(root)){
-            if ( v == left_most_leaf )
-                continue;
-            auto lb = cst.lb(v);
-            auto rb = cst.rb(v);
+        root_children(lcp, [&](uint64_t lb, uint64_t rb){
+            if ( rb == 0 ) // left most leaf
+                return;
             auto df_info = df(lb, rb);
             std::vector<uint64_t> buf;
             for (uint64_t i = std::get<1>(df_info); i <= std::get<2>(df_info); ++i) {
@@ -58,7 +52,7 @@ void construct_dup2(sdsl::cache_config& cc)
             for (size_t i=0; i < buf.size(); ++i){
                 dup2.push_back(buf[i]);
             }
-        }
+        });
         for (uint64_t i = next_idx; i < dup_mark.size(); ++i){
             dup_mark[i]=0;
         }
@@ -0,0 +1,84 @@
+#ifndef SURF_CONSTRUCT_R_HPP
+#define SURF_CONSTRUCT_R_HPP
+
+#include <sdsl/int_vector.hpp>
+#include "surf/config.hpp"
+#include "surf/lcp_intervals.hpp"
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace surf{
+
+//! Cache key of the repetition array sorted to the given depth.
+inline std::string key_r(uint64_t depth)
+{
+    return surf::KEY_R+"-"+std::to_string(depth);
+}
+
+//! Cache key of the WT over the repetition array sorted to the given depth.
+inline std::string key_wtr(uint64_t depth)
+{
+    return surf::KEY_WTR+"-"+std::to_string(depth);
+}
+
+// generate the repetition array R sorted to depth `depth` (= R1 in the
+// paper for depth 1). For each block of depth `depth` (see depth_blocks)
+// R holds the repetitions of the block, i.e. each document of the block
+// once less than it occurs there, sorted. The blocks are in the order of
+// U and Umark of the same depth (see construct_u), so the R interval of
+// a block starts at the number of 0s in Umark before it. A node up to
+// depth `depth` is a union of consecutive blocks and occurs in a
+// document as often as the document occurs in its U and R intervals.
+template<typename t_df>
+void construct_r(sdsl::cache_config& cc, uint64_t depth)
+{
+    using namespace sdsl;
+    using namespace std;
+
+    if ( depth == 0 ){
+        throw std::invalid_argument("the sorting depth of R has to be at least 1.");
+    }
+    string r_key = key_r(depth);
+    if (cache_file_exists(r_key, cc)){
+        return;
+    }
+    std::cout<<"generate "<<r_key<<" file"<<std::endl;
+    {
+        t_df df;
+        construct(df, "", cc, 0); // make sure that D and the LCP array were generated
+    }
+    int_vector_buffer<> D_array(cache_file_name(surf::KEY_DARRAY, cc));
+    cout<<".........D.size()="<<D_array.size()<<endl;
+    int_vector_buffer<> lcp(cache_file_name(conf::KEY_LCP, cc));
+    cout<<".........lcp.size()="<<lcp.size()<<endl;
+    int_vector_buffer<> R(cache_file_name(r_key,cc),
+                          std::ios::out, 1024*1024, D_array.width());
+    cout<<"R intialized"<<endl;
+
+    uint64_t doc_cnt = 0;
+    load_from_cache(doc_cnt, KEY_DOCCNT, cc);
+    std::vector<int64_t> last_occ(doc_cnt+1, -1);
+    uint64_t blocks = 0;
+    depth_blocks(lcp, depth, [&](uint64_t lb, uint64_t rb){
+        std::vector<uint64_t> buf;
+        for (auto i = lb; i<=rb; ++i){
+            auto x = D_array[i];
+            if ( last_occ[x] >= (int64_t)lb ){
+                buf.push_back(x);
+            }
+            last_occ[x] = i;
+        }
+        std::sort(buf.begin(), buf.end());
+        for (size_t i=0; i < buf.size(); ++i){
+            R.push_back(buf[i]);
+        }
+        ++blocks;
+    });
+    cout<<"R.size()="<<R.size()<<" blocks="<<blocks<<endl;
+}
+
+}// end namespace
+
+#endif
@@ -2,38 +2,47 @@
 #define SURF_CONSTRUCT_U_HPP
 
 #include <sdsl/int_vector.hpp>
-#include <type_traits>
+#include "surf/lcp_intervals.hpp"
+#include <stdexcept>
 
 namespace surf{
 
-// generate the U array (= D^1 in the paper) and
-// the KEY_UMARK bitvector
+//! Cache key of a structure built for the blocks of the given depth
+//! (see depth_blocks); depth 1 keeps the plain key.
+inline std::string key_depth(const std::string& key, uint64_t depth)
+{
+    return depth == 1 ? key : key+"-"+std::to_string(depth);
+}
+
+// generate the U array (= D^1 in the paper for depth 1) and
+// the KEY_UMARK bitvector. For each block of depth `depth` U holds the
+// sorted distinct documents of the block and Umark a 1 for each of them
+// followed by a 0 for each repetition in the block.
 template<typename t_df>
-void construct_u(sdsl::cache_config& cc)
+void construct_u(sdsl::cache_config& cc, uint64_t depth=1)
 {
     using namespace sdsl;
     using namespace std;
-    static_assert(std::is_same<typename t_df::cst_type::index_category, sdsl::cst_tag>::value, "CST class expected");
-
-    string u_file = cache_file_name(surf::KEY_U,cc);
-    if (!cache_file_exists(surf::KEY_U,cc)){
-        cout<<"......U does not exist. Generate it..."<<endl;
+    if ( depth == 0 ){
+        throw std::invalid_argument("the depth of the blocks of U has to be at least 1.");
+    }
+    string u_key = key_depth(surf::KEY_U, depth);
+    string umark_key = key_depth(surf::KEY_UMARK, depth);
+    if (!cache_file_exists(u_key,cc) or !cache_file_exists(umark_key,cc)){
+        cout<<"......"<<u_key<<" does not exist. Generate it..."<<endl;
         {
             t_df df;
-            construct(df, "", cc, 0); // make sure that the cst was generated
+            construct(df, "", cc, 0); // make sure that D and the LCP array were generated
         }
         int_vector_buffer<> D_array(cache_file_name(surf::KEY_DARRAY, cc));
         cout<<".........D.size()="<<D_array.size()<<endl;
         cout<<".........D.width()="<<(int)D_array.width()<<endl;
-        cout<<".........load cst"<<endl;
-        using t_cst = typename t_df::cst_type;
-        t_cst cst;
-        load_from_file(cst, cache_file_name<t_cst>(surf::KEY_TMPCST, cc));
-        cout<<".........cst.size()="<<cst.size()<<endl;
-        string u_file = cache_file_name(surf::KEY_U, cc);
+        int_vector_buffer<> lcp(cache_file_name(conf::KEY_LCP, cc));
+        cout<<".........lcp.size()="<<lcp.size()<<endl;
+        string u_file = cache_file_name(u_key, cc);
         int_vector_buffer<> U(u_file, std::ios::out,
                                    1024*1024, D_array.width());
-        string umark_file = cache_file_name(surf::KEY_UMARK, cc);
+        string umark_file = cache_file_name(umark_key, cc);
         int_vector_buffer<1> Umark(umark_file, std::ios::out);
 
         uint64_t doc_cnt = 0;
@@ -42,10 +51,7 @@ void construct_u(sdsl::cache_config& cc)
 
         std::vector<int64_t> last_occ(doc_cnt+1, -1);
 
-        auto root = cst.root();
-        for (auto& v : cst.children(root)){
-            auto lb = cst.lb(v);
-            auto rb = cst.rb(v);
+        depth_blocks(lcp, depth, [&](uint64_t lb, uint64_t rb){
             std::vector<uint64_t> buf;
             for (auto i = lb; i<=rb; ++i){
                 auto x = D_array[i];
@@ -62,9 +68,9 @@ void construct_u(sdsl::cache_config& cc)
             for (size_t i=0; i < rb-lb+1-buf.size(); ++i){
                 Umark.push_back(0);
             }
-        }
+        });
     }
-    cout << "U and Umark generated" << endl;
+    cout << u_key << " and " << umark_key << " generated" << endl;
 }
 
 }// end namespace
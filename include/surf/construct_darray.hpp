@@ -4,6 +4,7 @@
 #include "config.hpp"
 #include "construct_doc_perm.hpp"
 #include "construct_doc_border.hpp"
+#include "ram_budget.hpp"
 #include <sdsl/suffix_arrays.hpp>
 #include <algorithm>
 
@@ -28,11 +29,24 @@ void construct_darray(sdsl::cache_config& cc)
         doc_perm dp;
         load_from_cache(dp, KEY_DOCPERM,cc);
 
-        int_vector<> darray(sa.size(), 0, bits::hi(doc_cnt)+1);
-        for (uint64_t i=0; i<sa.size(); ++i){
-            darray[i] = dp.id2len[doc_border_rank(sa[i])];
+        uint8_t width = bits::hi(doc_cnt)+1;
+        if ( fits_ram_budget((sa.size()*width+7)/8) ){
+            int_vector<> darray(sa.size(), 0, width);
+            for (uint64_t i=0; i<sa.size(); ++i){
+                darray[i] = dp.id2len[doc_border_rank(sa[i])];
+            }
+            store_to_cache(darray, KEY_DARRAY, cc);
+        } else {
+            cout<<"stream darray to disk"<<endl;
+            {
+                int_vector_buffer<> darray(cache_file_name(KEY_DARRAY, cc),
+                                           std::ios::out, 1024*1024, width);
+                for (uint64_t i=0; i<sa.size(); ++i){
+                    darray.push_back(dp.id2len[doc_border_rank(sa[i])]);
+                }
+            }
+            register_cache_file(KEY_DARRAY, cc);
         }
-        store_to_cache(darray, KEY_DARRAY, cc);
     }
 }
 
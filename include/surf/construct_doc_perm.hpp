@@ -2,6 +2,8 @@
 #define SURF_CONSTRUCT_DOC_PERM_HPP
 
 #include "doc_perm.hpp"
+#include "construct_doc_cnt.hpp"
+#include "ram_budget.hpp"
 #include <sdsl/int_vector.hpp>
 #include <algorithm>
 #include <utility>
@@ -24,30 +26,64 @@ void construct_doc_perm(sdsl::cache_config& cc)
                       << " does not exist. Abort." << std::endl;
             return;
         }
+        construct_doc_cnt<t_width>(cc);
+        uint64_t doc_cnt = 0;
+        load_from_cache(doc_cnt, KEY_DOCCNT, cc);
         int_vector_buffer<t_width> text(text_file);
 
         std::cout<<"constructing doc_perm start"<<std::endl;
-        typedef std::pair<uint64_t, uint64_t> tPII;
-        std::vector<tPII> len_id; 
-        for (uint64_t i=0, doc_len=0,id=0; i < text.size(); ++i){
-            ++doc_len;
-            if ( 1 == text[i] ){
-                len_id.emplace_back(doc_len, id);
-                ++id;
-                doc_len = 0;
-            }
-        }
-        std::cout<<"now sorting..."<<std::endl;
-        std::sort(len_id.begin(),len_id.end());
-        std::cout<<"end sorting"<<std::endl;
         doc_perm dp;
-        dp.id2len = int_vector<>(len_id.size(), 0, sdsl::bits::hi(len_id.size()-1)+1);
+        dp.id2len = int_vector<>(doc_cnt, 0, sdsl::bits::hi(doc_cnt-1)+1);
         dp.len2id = dp.id2len;
-        for (size_t i=0; i<len_id.size(); ++i){
-            dp.id2len[len_id[i].second] = i;
+        typedef std::pair<uint64_t, uint64_t> tPII;
+        if ( fits_ram_budget(doc_cnt*sizeof(tPII)) ){
+            std::vector<tPII> len_id; 
+            for (uint64_t i=0, doc_len=0,id=0; i < text.size(); ++i){
+                ++doc_len;
+                if ( 1 == text[i] ){
+                    len_id.emplace_back(doc_len, id);
+                    ++id;
+                    doc_len = 0;
+                }
+            }
+            std::cout<<"now sorting..."<<std::endl;
+            std::sort(len_id.begin(),len_id.end());
+            std::cout<<"end sorting"<<std::endl;
+            for (size_t i=0; i<len_id.size(); ++i){
+                dp.id2len[len_id[i].second] = i;
+            }
+        } else {
+            // the ids are already ordered, so a stable counting sort by
+            // length gives the same order as sorting the (length, id) pairs
+            std::cout<<"counting sort by length..."<<std::endl;
+            uint64_t max_len = 0;
+            for (uint64_t i=0, doc_len=0; i < text.size(); ++i){
+                ++doc_len;
+                if ( 1 == text[i] ){
+                    max_len = std::max(max_len, doc_len);
+                    doc_len = 0;
+                }
+            }
+            int_vector<> doc_lens(doc_cnt, 0, sdsl::bits::hi(max_len)+1);
+            std::vector<uint64_t> len_start(max_len+2, 0);
+            for (uint64_t i=0, doc_len=0,id=0; i < text.size(); ++i){
+                ++doc_len;
+                if ( 1 == text[i] ){
+                    doc_lens[id++] = doc_len;
+                    ++len_start[doc_len+1];
+                    doc_len = 0;
+                }
+            }
+            for (size_t l=1; l<len_start.size(); ++l){
+                len_start[l] += len_start[l-1];
+            }
+            for (size_t id=0; id<doc_cnt; ++id){
+                dp.id2len[id] = len_start[doc_lens[id]]++;
+            }
+            std::cout<<"end sorting"<<std::endl;
         }
         std::cout << "inv perm..." << std::endl;
-        for (size_t i=0; i<len_id.size(); ++i){
+        for (size_t i=0; i<doc_cnt; ++i){
             dp.len2id[dp.id2len[i]] = i;
         }
         std::cout<<"constructing doc_perm end"<<std::endl;
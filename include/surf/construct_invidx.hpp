@@ -7,6 +7,7 @@
 #include "construct_doc_cnt.hpp"
 #include "surf/construct_darray.hpp"
 #include "surf/construct_doc_border.hpp"
+#include "surf/ram_budget.hpp"
 #include "sdsl/int_vector.hpp"
 
 namespace surf{
@@ -20,19 +21,38 @@ void construct_term_ranges(sdsl::int_vector<>& ids, sdsl::int_vector<>& sp,
     }
     register_cache_file(sdsl::conf::KEY_SA, cconfig);
 
-    sdsl::int_vector_buffer<> sa(cache_file_name(sdsl::conf::KEY_SA,cconfig));
-    sdsl::int_vector<> T;
-    load_from_cache(T,sdsl::conf::KEY_TEXT_INT,cconfig);
     size_t range_start = 0;
     std::vector<std::tuple<size_t,size_t,size_t>> ranges;
-    std::cout << "determine term ranges"<< std::endl;
-    for(size_t i=1;i<T.size();i++) {
-        if(T[sa[i]] != T[sa[i-1]]) {
-            ranges.emplace_back(T[sa[i-1]],range_start,i-1);
-            range_start = i;
+    sdsl::int_vector_buffer<> text(cache_file_name(sdsl::conf::KEY_TEXT_INT,cconfig));
+    if ( fits_ram_budget((text.size()*text.width()+7)/8) ) {
+        sdsl::int_vector_buffer<> sa(cache_file_name(sdsl::conf::KEY_SA,cconfig));
+        sdsl::int_vector<> T;
+        load_from_cache(T,sdsl::conf::KEY_TEXT_INT,cconfig);
+        std::cout << "determine term ranges"<< std::endl;
+        for(size_t i=1;i<T.size();i++) {
+            if(T[sa[i]] != T[sa[i-1]]) {
+                ranges.emplace_back(T[sa[i-1]],range_start,i-1);
+                range_start = i;
+            }
+        }
+        ranges.emplace_back(T[sa[T.size()-1]],range_start,T.size()-1);
+    } else {
+        // the SA is ordered by the first symbol of the suffixes, so the
+        // ranges follow from the symbol counts of the text
+        std::cout << "determine term ranges from symbol counts"<< std::endl;
+        std::vector<uint64_t> cnt;
+        for(size_t i=0;i<text.size();i++) {
+            uint64_t c = text[i];
+            if(c >= cnt.size()) cnt.resize(c+1, 0);
+            ++cnt[c];
+        }
+        for(size_t c=0;c<cnt.size();c++) {
+            if(cnt[c] > 0) {
+                ranges.emplace_back(c,range_start,range_start+cnt[c]-1);
+                range_start += cnt[c];
+            }
         }
     }
-    ranges.emplace_back(T[sa[T.size()-1]],range_start,T.size()-1);
     sp.resize(ranges.size());
     ep.resize(ranges.size());
     ids.resize(ranges.size());
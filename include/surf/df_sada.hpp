@@ -5,12 +5,19 @@
 #include "construct_doc_cnt.hpp"
 #include "construct_doc_border.hpp"
 #include "construct_darray.hpp"
+#include "work_stealing_pool.hpp"
+#include "ram_budget.hpp"
+#include "lcp_intervals.hpp"
 #include <sdsl/bit_vectors.hpp>
-#include <sdsl/suffix_trees.hpp>
+#include <sdsl/construct.hpp>
+#include <sdsl/suffix_arrays.hpp>
+#include <sdsl/wavelet_trees.hpp>
 #include <tuple>
 #include <string>
 #include <algorithm>
 #include <unordered_set>
+#include <thread>
+#include <vector>
 
 using std::string;
 
@@ -39,7 +46,6 @@ class df_sada{
         typedef t_sel select_type;
         typedef t_alphabet alphabet_category;
 
-        typedef sdsl::cst_sct3<sdsl::csa_wt<wt_int<rrr_vector<64>>>,sdsl::lcp_dac<>,sdsl::bp_support_sada<>,sdsl::bit_vector,sdsl::rank_support_v<>,sdsl::select_support_mcl<>> cst_type;
         typedef sdsl::wt_int<sdsl::bit_vector,
                              sdsl::rank_support_v<>,
                              sdsl::select_support_scan<1>,
@@ -48,16 +54,198 @@ class df_sada{
         bit_vector_type m_bv;
         select_type     m_sel;
 
+        //! Consecutive part of H and of the duplicate positions.
+        struct h_segment{
+            sdsl::bit_vector      h;
+            uint64_t              h_len = 0;
+            std::vector<uint64_t> dup;
+        };
+
+        /*! Part of the output which is generated independently of the others:
+         *  either the boundary pos between two children of the root, which
+         *  is the middle of the split range [lb,rb], or the boundaries in
+         *  (lb,rb] of the child [lb,rb] of the root, whose split ranges are
+         *  stored relative to lb.
+         */
+        struct h_piece{
+            bool               subtree = false;
+            uint64_t           lb = 0, rb = 0;
+            uint64_t           pos = 0;
+            sdsl::int_vector<> split_lb;
+            sdsl::int_vector<> split_rb;
+        };
+
+        /*! The children of a node [v_lb,v_rb] are split recursively into
+         *  halves. Returns the range [lb,rb] of the children which is split
+         *  at the j-th (starting at 1) of the d-1 child bounds.
+         */
+        static std::pair<uint64_t,uint64_t> split_range(uint64_t v_lb, uint64_t v_rb,
+                                                        const uint64_t* bounds, size_t d, size_t j){
+            size_t l = 1, r = d;
+            for (size_t mid = l + (r - l) / 2; mid != j; mid = l + (r - l) / 2){
+                if ( j < mid ){
+                    r = mid;
+                } else {
+                    l = mid + 1;
+                }
+            }
+            return {l == 1 ? v_lb : bounds[l-2], r == d ? v_rb : bounds[r-1]-1};
+        }
+
+        /*! Appends the duplicates of the split of [lb,rb] at pos to dup, i.e.
+         *  the positions in [lb,pos-1] of the documents which occur again
+         *  in [pos,rb].
+         */
+        static void split_dups(const wtc_type& wtc, uint64_t pos, uint64_t lb, uint64_t rb,
+                               std::vector<uint64_t>& dup){
+            if (lb + 1 == rb) {
+                if (wtc[rb] == lb) {
+                    dup.push_back(lb);
+                }
+            } else {
+                auto dup_info = restricted_unique_range_values(wtc, pos, rb, lb, pos-1);
+                dup.insert(dup.end(), dup_info.begin(), dup_info.end());
+            }
+        }
+
+        /*! Each boundary is encoded by its duplicates followed by a one. A
+         *  split range which lies in a single block of D_split contains no
+         *  duplicates.
+         */
+        static void generate_piece(const wtc_type& wtc, const sdsl::rank_support_v<>& split_rank,
+                                   const h_piece& p, h_segment& seg){
+            auto add_split = [&](uint64_t pos, uint64_t lb, uint64_t rb){
+                size_t dup_elements = seg.dup.size();
+                if ( split_rank(rb) > split_rank(lb) ) {
+                    split_dups(wtc, pos, lb, rb, seg.dup);
+                }
+                seg.h_len += seg.dup.size() - dup_elements;
+                seg.h[seg.h_len++] = 1;
+            };
+            if ( p.subtree ){
+                // a subtree of size s contains less than s duplicates
+                seg.h = sdsl::bit_vector(2*(p.rb-p.lb+1), 0);
+                for (uint64_t pos = p.lb+1; pos <= p.rb; ++pos){
+                    uint64_t i = pos-p.lb-1;
+                    add_split(pos, p.lb+p.split_lb[i], p.lb+p.split_rb[i]);
+                }
+            } else {
+                if ( split_rank(p.rb) > split_rank(p.lb) ) {
+                    split_dups(wtc, p.pos, p.lb, p.rb, seg.dup);
+                }
+                seg.h = sdsl::bit_vector(seg.dup.size()+1, 0);
+                seg.h_len = seg.dup.size();
+                seg.h[seg.h_len++] = 1;
+            }
+        }
+
+        /*! Generates H and the duplicate positions from one pass over the
+         *  LCP array, which enumerates the LCP intervals bottom-up. H holds
+         *  for each boundary 1..n-1 between two suffixes the duplicates of
+         *  the split at this boundary followed by a one. The boundaries in a
+         *  child of the root are complete once the child is reported; they
+         *  are generated in parallel, as are the splits of the root, and
+         *  passed to out in order, so the result is independent of the
+         *  number of threads. To bound the memory, the pieces are processed
+         *  in batches which produce about n/32 duplicates at most.
+         */
+        template<class t_lcp, class t_out>
+        static void construct_h(t_lcp& lcp, const wtc_type& wtc,
+                                const sdsl::rank_support_v<>& split_rank,
+                                size_t threads, t_out out){
+            using namespace sdsl;
+            const uint64_t n = lcp.size();
+            const uint64_t batch_size = std::max((uint64_t)1, n/32);
+            std::vector<uint64_t> root_bounds;
+            root_children(lcp, [&root_bounds](uint64_t lb, uint64_t){
+                if ( lb > 0 ){
+                    root_bounds.push_back(lb);
+                }
+            });
+            const size_t root_deg = root_bounds.size()+1;
+            cout<<"root degree="<<root_deg<<endl;
+
+            std::vector<h_piece> pieces;
+            std::vector<h_segment> segs;
+            uint64_t batch_load = 0;
+            auto run_batch = [&](){
+                segs.resize(pieces.size());
+                work_stealing_pool::run(pieces.size(), threads, [&](size_t i, size_t){
+                    generate_piece(wtc, split_rank, pieces[i], segs[i]);
+                });
+                for (auto& seg : segs){
+                    out(seg);
+                }
+                pieces.clear();
+                segs.clear();
+                batch_load = 0;
+            };
+            size_t next_root_bound = 0;
+            auto add_root_splits = [&](uint64_t up_to){
+                for (; next_root_bound < root_bounds.size() and root_bounds[next_root_bound] <= up_to;
+                       ++next_root_bound){
+                    auto r = split_range(0, n-1, root_bounds.data(), root_deg, next_root_bound+1);
+                    h_piece p;
+                    p.pos = root_bounds[next_root_bound];
+                    p.lb = r.first;
+                    p.rb = r.second;
+                    // at most one duplicate per position of the smaller half
+                    batch_load += std::min(p.pos-p.lb, p.rb-p.pos+1);
+                    pieces.push_back(std::move(p));
+                    if ( batch_load >= batch_size ){
+                        run_batch();
+                    }
+                }
+            };
+
+            h_piece cur; // the child of the root which is currently enumerated
+            lcp_intervals(lcp, [&](const lcp_interval& v){
+                if ( v.lcp == 0 ){ // root
+                    return;
+                }
+                if ( !cur.subtree ){
+                    size_t c = std::upper_bound(root_bounds.begin(), root_bounds.end(), v.lb)
+                               - root_bounds.begin();
+                    cur.subtree = true;
+                    cur.lb = c ? root_bounds[c-1] : 0;
+                    cur.rb = c < root_bounds.size() ? root_bounds[c]-1 : n-1;
+                    uint8_t width = bits::hi(cur.rb-cur.lb)+1;
+                    cur.split_lb = int_vector<>(cur.rb-cur.lb, 0, width);
+                    cur.split_rb = int_vector<>(cur.rb-cur.lb, 0, width);
+                }
+                size_t d = v.degree();
+                for (size_t j = 1; j < d; ++j){
+                    auto r = split_range(v.lb, v.rb, v.bounds, d, j);
+                    uint64_t i = v.bounds[j-1]-cur.lb-1;
+                    cur.split_lb[i] = r.first-cur.lb;
+                    cur.split_rb[i] = r.second-cur.lb;
+                }
+                if ( v.parent_lcp == 0 ){ // the child of the root is complete
+                    add_root_splits(cur.lb);
+                    batch_load += cur.rb-cur.lb+1;
+                    pieces.push_back(std::move(cur));
+                    cur = h_piece();
+                    if ( batch_load >= batch_size ){
+                        run_batch();
+                    }
+                }
+            });
+            add_root_splits(n);
+            run_batch();
+        }
+
     public:    
 
         df_sada()=default;
 
         //! Constructor
-        /*! \param cc cache_config which should contain the
-         *         following files:
-         *           - 
+        /*! \param cc      cache_config which should contain the
+         *                 following files:
+         *                   - 
+         *  \param threads Number of threads used to generate H.
          */
-        df_sada(sdsl::cache_config& cc){
+        df_sada(sdsl::cache_config& cc,
+                size_t threads=std::max(1U, std::thread::hardware_concurrency())){
             using namespace sdsl;
             auto event = memory_monitor::event("construct df_sada");
 
@@ -71,11 +259,9 @@ class df_sada{
                 return;
             }
 
-            cst_type temp_cst;
             wtc_type wtc;
-
-            load_from_file(temp_cst, cache_file_name<cst_type>(surf::KEY_TMPCST, cc));
             load_from_file(wtc, cache_file_name<wtc_type>(surf::KEY_WTC, cc));
+            int_vector_buffer<> lcp(cache_file_name(conf::KEY_LCP, cc));
 
             // int_vector_buffer which will contain the positions of the duplicates in the
             // C array after this scope
@@ -111,76 +297,25 @@ class df_sada{
             
 
             // construct the bv
+            cout<<"construct H using "<<threads<<" threads"<<endl;
             bit_vector h(2 * D.size(), 0);
             util::set_to_value(h,0);
             size_t h_idx = 0, dup_idx = 0;
-            using n_type = std::tuple<cst_sct3<>::node_type, size_t, size_t, bool>;
-            std::stack<n_type> s;
-            s.emplace(temp_cst.root(), 1, temp_cst.degree(temp_cst.root()), true);
-            // invariant: node has two children
-            while (!s.empty()) {
-                n_type node = s.top();
-                s.pop();
-                auto v = std::get<0>(node);
-                auto l_child = std::get<1>(node);
-                auto r_child = std::get<2>(node);
-                auto first = std::get<3>(node);
-                if (first) {  // first half
-                    // recurse down
-                    std::get<3>(node) = false;
-                    auto lb = temp_cst.lb(temp_cst.select_child(v, l_child));
-                    auto rb = temp_cst.rb(temp_cst.select_child(v, r_child));
-                    if ( D_split_rank(rb) > D_split_rank(lb) ) {
-                        s.push(node);
-                        if (r_child == l_child + 1) {
-                            auto w = temp_cst.select_child(v, l_child);
-                            if (!temp_cst.is_leaf(w)) s.emplace(w, 1, temp_cst.degree(w), true);
-                        } else {
-                            auto mid = l_child + (r_child - l_child) / 2;
-                            s.emplace(v, l_child, mid, true);
-                        }
-                    } else {
-                        for (size_t i=0; i<rb-lb; ++i) {
-                            h[h_idx++] = 1;
-                        }
-                    }
-                } else {  // second half
-                    auto lb = temp_cst.lb(temp_cst.select_child(v, l_child));
-                    auto rb = temp_cst.rb(temp_cst.select_child(v, r_child));
-                    auto mid = l_child + (r_child - l_child) / 2;
-                    size_t dup_elements = 0;
-//                    if ( D_split_rank(lb) == D_split_rank(rb) ) {
-//                    }
-//                    else 
-                    if (lb + 1 == rb) {
-                        dup_elements = (wtc[rb] == lb);
-                        if (dup_elements) {
-                            temp_dup[dup_idx++] = lb;
-                        }
-                    } else {
-                        auto mid_rb = temp_cst.rb(temp_cst.select_child(v, mid));
-                        auto mid_lb = mid_rb + 1;
-                        auto dup_info = restricted_unique_range_values(wtc, mid_lb, rb, lb, mid_rb);
-                        dup_elements = dup_info.size();
-                        for (auto& dup : dup_info) {
-                            temp_dup[dup_idx++] = dup;
-                        }
-                    }
-                    h_idx += dup_elements;
-                    h[h_idx++] = 1;
-                    if (mid + 1 == r_child) {
-                        auto w = temp_cst.select_child(v, r_child);
-                        if (!temp_cst.is_leaf(w)) s.emplace(w, 1, temp_cst.degree(w), true);
-                    } else {
-                        s.emplace(v, mid + 1, r_child, true);
-                    }
+            construct_h(lcp, wtc, D_split_rank, threads,
+                        [&](const h_segment& seg){
+                for (uint64_t i = 0; i < seg.h_len; i += 64){
+                    uint8_t len = std::min((uint64_t)64, seg.h_len - i);
+                    h.set_int(h_idx, seg.h.get_int(i, len), len);
+                    h_idx += len;
                 }
-            }
+                for (auto dup : seg.dup){
+                    temp_dup[dup_idx++] = dup;
+                }
+            });
             std::cerr<<"h_idx="<<h_idx<<std::endl;
             std::cerr<<"dup_idx="<<dup_idx<<std::endl;
             h.resize(h_idx);
             store_to_cache(h, KEY_H, cc);
-            util::clear(temp_cst);
             // convert to proper bv type
             m_bv = bit_vector_type(h);
             util::clear(wtc);
@@ -211,6 +346,83 @@ class df_sada{
             return std::make_tuple(ep - sp + 1 - dup, dup_begin, dup_end);
         }
 
+        //! Document frequencies and duplication array ranges of many intervals
+        /*! \param ranges    Term intervals [sp,ep].
+         *  \param scan_words Maximal number of 64-bit words of H which are
+         *                    scanned after the previous select result
+         *                    before a select query is issued.
+         *  \return The triples of operator() in the order of ranges.
+         *
+         *  The select arguments of all intervals are answered in sorted
+         *  order. Equal arguments are answered once and close ones are
+         *  found by scanning the words after the previous position, which
+         *  are mostly in the blocks the previous select already decoded.
+         *  The scan is bounded in bits, not in ones, as a single run of
+         *  zeros (the duplicates of one split) in H can be long.
+         */
+        std::vector<std::tuple<uint64_t,uint64_t,uint64_t>>
+        batch(const std::vector<std::pair<uint64_t,uint64_t>>& ranges,
+              uint64_t scan_words=8) const{
+            // select arguments; the lowest bit of the second element tells
+            // if it is the left (0) or right (1) bound of the interval
+            std::vector<std::pair<uint64_t,uint64_t>> args;
+            args.reserve(2*ranges.size());
+            for (uint64_t i = 0; i < ranges.size(); ++i){
+                if ( ranges[i].first > 0 ){
+                    args.emplace_back(ranges[i].first, 2*i);
+                }
+                args.emplace_back(ranges[i].second, 2*i+1);
+            }
+            std::sort(args.begin(), args.end());
+            std::vector<uint64_t> pos(2*ranges.size());
+            uint64_t prev_k = 0, prev_pos = 0;
+            for (uint64_t j = 0; j < args.size(); ++j){
+                uint64_t k = args[j].first;
+                if ( j > 0 and k == prev_k ){
+                    pos[args[j].second] = prev_pos;
+                    continue;
+                }
+                bool found = false;
+                if ( j > 0 and k - prev_k <= 64*scan_words ){
+                    uint64_t need = k - prev_k;
+                    uint64_t p = prev_pos + 1;
+                    for (uint64_t l = 0; l < scan_words and p < m_bv.size(); ++l){
+                        uint64_t len = std::min((uint64_t)64, m_bv.size() - p);
+                        uint64_t w = m_bv.get_int(p, len);
+                        uint64_t cnt = sdsl::bits::cnt(w);
+                        if ( cnt >= need ){
+                            prev_pos = p + sdsl::bits::sel(w, need);
+                            found = true;
+                            break;
+                        }
+                        need -= cnt;
+                        p += len;
+                    }
+                }
+                if ( !found ){
+                    prev_pos = m_sel(k);
+                }
+                prev_k = k;
+                pos[args[j].second] = prev_pos;
+            }
+            std::vector<std::tuple<uint64_t,uint64_t,uint64_t>> res;
+            res.reserve(ranges.size());
+            for (uint64_t i = 0; i < ranges.size(); ++i){
+                uint64_t sp = ranges[i].first, ep = ranges[i].second;
+                uint64_t y = pos[2*i+1];
+                uint64_t dup_end = (y + 1) - ep - 1;
+                uint64_t dup_begin = 0;
+                uint64_t dup = (y + 1) - ep;
+                if ( sp > 0 ){
+                    uint64_t x = pos[2*i];
+                    dup_begin = (x+1) - sp;
+                    dup -= dup_begin;
+                }
+                res.emplace_back(ep - sp + 1 - dup, dup_begin, dup_end);
+            }
+            return res;
+        }
+
         size_type serialize(std::ostream& out, sdsl::structure_tree_node* v = NULL, string name = "") const {
             using namespace sdsl;
             structure_tree_node* child = structure_tree::add_child(v, name, util::class_name(*this));
@@ -249,12 +461,6 @@ void construct(df_sada<t_bv,t_sel,t_alphabet> &idx, const string& file,
         }
     }
     register_cache_file(conf::KEY_LCP, cc);
-    using cst_type = typename df_sada<t_bv,t_sel,t_alphabet>::cst_type;
-    if (!cache_file_exists<cst_type>(KEY_TMPCST, cc)) {
-        auto event = memory_monitor::event("construct temp_cst");
-        cst_type temp_cst = cst_type(cc, true);
-        store_to_file(temp_cst, cache_file_name<cst_type>(surf::KEY_TMPCST, cc));
-    } 
 
     construct_doc_cnt<t_alphabet::WIDTH>(cc);
     uint64_t doc_cnt = 0;
@@ -300,16 +506,78 @@ void construct(df_sada<t_bv,t_sel,t_alphabet> &idx, const string& file,
     if (!cache_file_exists(surf::KEY_DUP, cc)){
         cout<<"construct dup"<<endl;
         auto event = memory_monitor::event("construct dup");
-        int_vector<> D_array;
-        load_from_file(D_array, d_file);
         int_vector_buffer<> tmpdup(cache_file_name(surf::KEY_TMPDUP,cc));
         string dup_file = cache_file_name(surf::KEY_DUP, cc);
         int_vector_buffer<> dup(dup_file, std::ios::out,
                                          1024*1024, D.width());
         cout << "tmpdup.size()="<<tmpdup.size()<<endl;
         cout << "D.width()="<<(int)D.width()<<endl;
-        for (size_t i = 0; i < tmpdup.size(); ++i){
-            dup[i] = D_array[tmpdup[i]];
+        // next to D the step holds the buffers of the three streams and
+        // dup_in_node of the sort below
+        const uint64_t stream_buf = 1024*1024;
+        uint64_t resident = 3*stream_buf + (doc_cnt+1)*sizeof(uint64_t);
+        if ( fits_ram_budget((D.size()*D.width()+7)/8 + resident) ){
+            int_vector<> D_array;
+            load_from_file(D_array, d_file);
+            for (size_t i = 0; i < tmpdup.size(); ++i){
+                dup[i] = D_array[tmpdup[i]];
+            }
+        } else {
+            // D is loaded in chunks. The positions of tmpdup are first
+            // distributed to one bucket file per chunk in a single pass,
+            // each bucket is then mapped to D with its chunk in memory,
+            // and a last pass over tmpdup reads the buckets back in order.
+            const uint64_t bucket_buf = 64*1024;
+            uint64_t avail = construct_ram_budget() > resident ? construct_ram_budget() - resident : 0;
+            uint64_t chunks = 1;
+            auto chunk_bytes = [&](uint64_t c){
+                return (((D.size()+c-1)/c)*D.width()+7)/8 + c*bucket_buf;
+            };
+            while ( chunks < D.size() and chunk_bytes(chunks) > avail and (chunks+1)*bucket_buf <= avail ){
+                ++chunks;
+            }
+            uint64_t chunk_size = std::max((uint64_t)1, (D.size()+chunks-1)/chunks);
+            cout << "map tmpdup to D in "<<chunks<<" chunks"<<endl;
+            uint8_t bucket_width = std::max((uint8_t)(bits::hi(chunk_size)+1), D.width());
+            std::vector<string> bucket_files;
+            std::vector<int_vector_buffer<>> buckets;
+            buckets.reserve(chunks);
+            for (uint64_t c = 0; c < chunks; ++c){
+                bucket_files.push_back(cache_file_name(surf::KEY_TMPDUP+"_chunk"+std::to_string(c), cc));
+                buckets.emplace_back(bucket_files.back(), std::ios::out, bucket_buf, bucket_width);
+            }
+            for (size_t i = 0; i < tmpdup.size(); ++i){
+                uint64_t pos = tmpdup[i];
+                buckets[pos/chunk_size].push_back(pos%chunk_size);
+            }
+            for (auto& bucket : buckets){
+                bucket.close();
+            }
+            buckets.clear();
+            {
+                int_vector<> D_chunk(chunk_size, 0, D.width());
+                for (uint64_t c = 0; c < chunks; ++c){
+                    uint64_t b = c*chunk_size, e = std::min(D.size(), b + chunk_size);
+                    for (uint64_t j = b; j < e; ++j){
+                        D_chunk[j-b] = D[j];
+                    }
+                    int_vector_buffer<> bucket(bucket_files[c], std::ios::in, bucket_buf);
+                    for (uint64_t j = 0; j < bucket.size(); ++j){
+                        bucket[j] = D_chunk[bucket[j]];
+                    }
+                }
+            }
+            std::vector<uint64_t> next(chunks, 0);
+            for (uint64_t c = 0; c < chunks; ++c){
+                buckets.emplace_back(bucket_files[c], std::ios::in, bucket_buf);
+            }
+            for (size_t i = 0; i < tmpdup.size(); ++i){
+                uint64_t c = tmpdup[i]/chunk_size;
+                dup[i] = buckets[c][next[c]++];
+            }
+            for (auto& bucket : buckets){
+                bucket.close(true);
+            }
         }
 //        std::map<uint64_t, uint64_t> node_list_len;
         std::vector<uint64_t> dup_in_node(doc_cnt+1, 0);
@@ -5,8 +5,17 @@
 #include "surf/df_sada.hpp"
 #include "surf/rank_functions.hpp"
 #include "surf/construct_col_len.hpp"
+#include "surf/wt_search.hpp"
+#include "surf/shared_topk.hpp"
+#include "surf/work_stealing_pool.hpp"
+#include "surf/term_cache.hpp"
+#include "surf/term_stats.hpp"
+#include "surf/tf_bounds.hpp"
+#include "surf/range_table.hpp"
+#include "surf/topk_lists.hpp"
 #include <algorithm>
 #include <limits>
+#include <memory>
 #include <queue>
 
 namespace surf{
@@ -19,6 +28,8 @@ struct term_info{
     uint64_t sp_Dt; // start of interval for term t in the suffix array
     uint64_t ep_Dt; // end of interval for term t in the suffix array
     uint64_t f_Dt;  // number of distinct document the term occurs in 
+    uint64_t tfb_row = 0; // row of the term in the tf bounds of idx_d (0 = none)
+    uint64_t rt_row = 0;  // row of the term in the range table of idx_d (0 = none)
 
     term_info() = default;
     term_info(const std::vector<uint64_t>& t, uint64_t f_qt, uint64_t sp_Dt, uint64_t ep_Dt, uint64_t f_Dt) : 
@@ -36,44 +47,35 @@ struct term_info{
     }
 };
 
-template<typename t_wt_node>
-struct s_state_t{
-    double score;
-    t_wt_node v;
-    std::vector<term_info*> t_ptrs; // pointers to term_info array
-    std::vector<range_type> r; // ranges
-
-    s_state_t() = default;
-
-    s_state_t(double score, const t_wt_node& v, 
-              const std::vector<term_info*>& t_ptrs,
-              const std::vector<range_type>& r):
-        score(score), v(v), t_ptrs(t_ptrs),
-        r(r){}
-
-    s_state_t(s_state_t&&) = default;
-    s_state_t(const s_state_t&) = default;
-
-    s_state_t& operator=(s_state_t&&) = default;
-    s_state_t& operator=(const s_state_t&) = default;
-
-    bool operator<(const s_state_t& s)const{
-        if ( score != s.score ){
-            return score < s.score;
-        }
-        return v < s.v;
+//! Statistics of the query terms as used by topk_lists
+inline std::vector<topk_term> topk_terms(const std::vector<term_info>& terms)
+{
+    std::vector<topk_term> res;
+    for (const auto& t : terms){
+        res.push_back({t.t.size() == 1 ? t.t[0] : topk_term::phrase, t.f_qt, t.f_Dt, t.F_Dt()});
     }
-};
+    return res;
+}
 
 /*! Class idx_d consists of a 
  *   - CSA over the collection concatenation
  *   - document frequency structure
  *   - a WT over the D array
+ *   - optionally, term frequency bounds for the upper levels of the WT
+ *     (t_tfb=tf_bounds<...>), which tighten the scores of inner nodes
+ *   - optionally, the ranges of the frequent terms on a level of the WT
+ *     (t_rt=range_table<...>), so that the traversal of a query which
+ *     contains a frequent term starts on that level
+ *   - optionally, the top-K lists of the heavy terms (t_topk=topk_lists),
+ *     which answer single-term queries and give an initial threshold
  */
 template<typename t_csa,
          typename t_wtd,
          typename t_df,
-         typename t_ranker=rank_bm25<>>
+         typename t_ranker=rank_bm25<>,
+         typename t_tfb=no_tf_bounds,
+         typename t_rt=no_range_table,
+         typename t_topk=no_topk_lists>
 class idx_d{
 public:
     using size_type = sdsl::int_vector<>::size_type;
@@ -82,139 +84,224 @@ public:
     typedef typename wtd_type::node_type node_type;
     typedef t_df     df_type;
     typedef t_ranker ranker_type;
+    typedef t_tfb    tfb_type;
+    typedef t_rt     rt_type;
+    typedef t_topk   topk_type;
 public:
     csa_type    m_csa;
     wtd_type    m_wtd;
     df_type     m_df;
     doc_perm    m_docperm;
     ranker_type m_ranker;
-
-    using state_type = s_state_t<typename t_wtd::node_type>;
+    tfb_type    m_tfb;
+    rt_type     m_rt;
+    term_stats  m_tstats;
+    topk_type   m_topk;
+    mutable surf::term_cache m_term_cache;
+private:
+    size_t      m_search_threads = 1;
+    std::shared_ptr<work_stealing_pool> m_pool; // workers of the parallel traversal
+    direct_cost_model m_cost;
+    std::vector<node_type> m_rt_nodes; // nodes of the level of m_rt, built at load
 public:
 
+    /*! Number of threads used to traverse the WT of a single query. The
+     *  threads are started here and shared by all queries; the thread
+     *  which runs a query is one of them.
+     */
+    void set_search_threads(size_t threads){
+        m_search_threads = std::max((size_t)1, threads);
+        m_pool.reset();
+        if ( m_search_threads > 1 ){
+            m_pool = std::make_shared<work_stealing_pool>(m_search_threads);
+        }
+    }
+
+    //! Cache of the term ranges and document frequencies used by search.
+    const surf::term_cache& term_cache()const{
+        return m_term_cache;
+    }
+
     result search(const std::vector<query_token>& qry,size_t k,bool ranked_and = false,bool profile = false) const {
-        typedef std::priority_queue<state_type> pq_type;
-        typedef std::priority_queue<double, std::vector<double>, std::greater<double>> pq_min_type;
+        if ( k == 0 ){
+            return result();
+        }
         std::vector<term_info> terms;
-        std::vector<term_info*> term_ptrs;
-        std::vector<range_type> ranges;
-        result res;
+        std::vector<range_type> v_ranges;
+        uint64_t occ = 0; // total size of the ranges
 
+        for (size_t i=0; i<qry.size(); ++i){
+            term_range_info info;
+            uint64_t c;
+            if ( !m_tstats.lookup(m_csa, qry[i].token_ids, info, c) ) {
+                info = m_term_cache.lookup(m_csa, m_df, qry[i].token_ids);
+            }
+            if ( !info.empty() ) {
+                terms.emplace_back(qry[i].token_ids, qry[i].f_qt, info.sp, info.ep, info.f_Dt);
+                terms.back().tfb_row = m_tfb.row(qry[i].token_ids);
+                terms.back().rt_row = m_rt.row(qry[i].token_ids);
+                v_ranges.emplace_back(info.sp, info.ep);
+                occ += info.ep - info.sp + 1;
+            }
+        }
+        result res;
+        auto topk_qry = topk_terms(terms);
+        if ( terms.size() == 1 and m_topk.answer(m_ranker, topk_qry[0], k, profile, res) ){
+            if(profile) {
+                res.wt_nodes = 2*m_wtd.sigma-1;
+            }
+            return res;
+        }
+        auto tf = [this,&terms](size_t i, const node_type& v, const wt_term_ranges& r){
+            return m_tfb.bound(terms[i].tfb_row, v.level, m_wtd.sym(v), size(r.v));
+        };
+        // below the levels with tf bounds the bound of a term only
+        // depends on the size of its range
+        no_wt wtr;
+        auto search = make_wt_search(m_wtd, wtr, m_docperm, m_ranker, terms, tf,
+                                     tfb_type::enabled ? m_tfb.levels() : 0);
+        search.set_term_dropping(true);
+        if ( m_cost.direct(occ, k) ){
+            res = search.direct(v_ranges, k, ranked_and, profile);
+        } else {
+            double threshold = m_topk.threshold(m_ranker, topk_qry, k, ranked_and);
+            if ( m_search_threads > 1 ){
+                res = search_parallel(search, terms, k, ranked_and, profile, threshold);
+            } else if ( rt_type::enabled and from_range_table(terms) ){
+                res = search(level_ranges(terms, m_rt_nodes, m_rt.levels()), k, ranked_and, profile, threshold);
+            } else {
+                res = search(v_ranges, {}, k, ranked_and, profile, threshold);
+            }
+        }
         if(profile) {
             res.wt_nodes = 2*m_wtd.sigma-1;
         }
+        return res;
+    }
 
-        for (size_t i=0; i<qry.size(); ++i){
-            size_type sp=1, ep=0;
-            if ( backward_search(m_csa, 0, m_csa.size()-1, 
-                                 qry[i].token_ids.begin(),
-                                 qry[i].token_ids.end(),
-                                 sp, ep) > 0 ) {
-                auto f_Dt = std::get<0>(m_df(sp,ep)); // document frequency
-                terms.emplace_back(qry[i].token_ids, qry[i].f_qt, sp, ep,  f_Dt);
-                ranges.emplace_back(sp, ep);
+private:
+    //! True if a query term is in the range table
+    bool from_range_table(const std::vector<term_info>& terms)const{
+        for (const auto& t : terms){
+            if ( t.rt_row != 0 ){
+                return true;
             }
         }
-        term_ptrs.resize(terms.size()); 
-        for (size_type i=0; i<terms.size(); ++i){
-            term_ptrs[i] = &terms[i];
-        }
-        double initial_term_num = terms.size();
-
-        auto push_node = [this,&initial_term_num, &res,&profile,&ranked_and]
-                         (pq_type& pq, const std::vector<term_info*>& t_ptrs,node_type& v,
-                          std::vector<range_type>& r,
-                          pq_min_type& pq_min, const size_t& k){
-            auto min_idx = m_wtd.sym(v) << (m_wtd.max_level - v.level);  
-            auto min_doc_len = m_ranker.doc_length(m_docperm.len2id[min_idx]);
-            state_type t; // new state
-            t.v = v;
-
-            t.score = initial_term_num * m_ranker.calc_doc_weight(min_doc_len);
+        return false;
+    }
 
-            bool eval = false;
-            bool is_leaf = m_wtd.is_leaf(v);
-            for (size_t i = 0; i < r.size(); ++i){
-                if ( !empty(r[i]) ){
-                    eval = true;
-                    t.r.push_back(r[i]);
-                    t.t_ptrs.push_back(t_ptrs[i]);
+    /*! Ranges of the query terms in the nodes of a level of the WT. The
+     *  ranges of terms which are in the range table are taken from it if
+     *  it is the level of the table, the others are mapped down from the
+     *  root.
+     */
+    level_start<node_type> level_ranges(const std::vector<term_info>& terms,
+                                        const std::vector<node_type>& level_nodes,
+                                        uint64_t level)const{
+        const size_t nodes = level_nodes.size();
+        level_start<node_type> start{level_nodes, std::vector<range_type>(terms.size()*nodes)};
+        for (size_t i = 0; i < terms.size(); ++i){
+            range_type* r = start.ranges.data() + i*nodes;
+            if ( terms[i].rt_row != 0 and level == m_rt.levels() ){
+                m_rt.ranges(terms[i].rt_row, r);
+            } else {
+                wt_level_ranges(m_wtd, range_type(terms[i].sp_Dt, terms[i].ep_Dt), level, r);
+            }
+        }
+        return start;
+    }
 
-                    auto score = m_ranker.calculate_docscore(
-                                 t.t_ptrs.back()->f_qt,
-                                 size(t.r.back()),
-                                 t.t_ptrs.back()->f_Dt,
-                                 t.t_ptrs.back()->F_Dt(),
-                                 min_doc_len,
-                                 is_leaf
-                               );
-                    t.score += score;
-                } else if ( ranked_and ){
-                    return;
-                }
+    /*! Parallel version of the traversal. The nodes of a level of the WT
+     *  are the roots of subtrees, each of which is traversed by wt_search
+     *  as one task of the pool started by set_search_threads. The traversals
+     *  share a top-k and prune against its k-th score. The level is the
+     *  one of the range table if a query term is in it, otherwise one
+     *  with a few subtrees per thread. The nodes above it are not counted
+     *  in the search space. Documents with the same score as the k-th
+     *  result may be chosen differently than in the sequential traversal.
+     */
+    template<class t_search>
+    result search_parallel(t_search wts, const std::vector<term_info>& terms, size_t k,
+                           bool ranked_and, bool profile, double threshold)const{
+        result res;
+        const size_t n = terms.size();
+        std::vector<node_type> split_nodes;
+        uint64_t split_level = m_rt.levels();
+        if ( !(rt_type::enabled and from_range_table(terms)) ){
+            split_level = std::min((uint64_t)m_wtd.max_level,
+                                   (uint64_t)sdsl::bits::hi(4*m_search_threads-1)+1);
+            split_nodes = wt_level_nodes(m_wtd, split_level);
+        }
+        auto start = level_ranges(terms, split_nodes.empty() ? m_rt_nodes : split_nodes, split_level);
+        const size_t nodes = start.nodes.size();
+
+        // one task per subtree which holds a query term (all of them for
+        // ranked AND); the ones with more occurrences first
+        std::vector<std::pair<uint64_t, size_t>> occ_node;
+        for (size_t j = 0; j < nodes; ++j){
+            uint64_t occ = 0;
+            size_t cnt = 0;
+            for (size_t i = 0; i < n; ++i){
+                occ += size(start.ranges[i*nodes + j]);
+                cnt += !empty(start.ranges[i*nodes + j]);
             }
-            if (!eval){
-                return;
+            if ( cnt > 0 and (!ranked_and or cnt == n) ){
+                occ_node.emplace_back(occ, j);
             }
-            if ( pq_min.size() < k ){ // not yet k leaves in score queue
-                pq.emplace(t);
-                if (profile) res.wt_search_space++;
-                if ( m_wtd.is_leaf(t.v) )
-                    pq_min.push(t.score);
-            } else { // more than k leaves in score queue
-                if ( t.score > pq_min.top() ){
-                    pq.emplace(t);
-                    if (profile) res.wt_search_space++;
-                    if ( m_wtd.is_leaf(t.v) ){
-                        pq_min.pop();
-                        pq_min.push(t.score);
-                    }
-                } 
+        }
+        std::sort(occ_node.begin(), occ_node.end(), std::greater<std::pair<uint64_t, size_t>>());
+        std::vector<std::vector<node_type>> task_nodes;
+        for (const auto& x : occ_node){
+            task_nodes.push_back({start.nodes[x.second]});
+        }
+        std::vector<level_start<node_type>> tasks;
+        for (size_t t = 0; t < occ_node.size(); ++t){
+            tasks.push_back({task_nodes[t], std::vector<range_type>(n)});
+            for (size_t i = 0; i < n; ++i){
+                tasks.back().ranges[i] = start.ranges[i*nodes + occ_node[t].second];
             }
-        };
-
-        constexpr double max_score = std::numeric_limits<double>::max();
-        
-        pq_min_type pq_min;
-        pq_type pq;
-        pq.emplace(max_score, m_wtd.root(), term_ptrs, ranges);
-        if(profile) res.wt_search_space++;
+        }
 
-        while ( !pq.empty() and res.list.size() < k ) {
-            state_type s = pq.top();
-            pq.pop();
-            if ( m_wtd.is_leaf(s.v) ){
-                res.list.emplace_back(m_docperm.len2id[m_wtd.sym(s.v)], s.score);
-            } else {
-//fast_expand:               
-                auto exp_v = m_wtd.expand(s.v);
-                bool left_empty = m_wtd.empty(std::get<0>(exp_v));
-                bool right_empty = m_wtd.empty(std::get<1>(exp_v));
-                auto exp_r = m_wtd.expand(s.v, std::move(s.r));
-                if ( std::get<1>(exp_r).size() == 0 and std::get<0>(exp_r).size() > 0 and !m_wtd.is_leaf(std::get<0>(exp_v) )){
-                    std::cout<<"easy"<<std::endl;
-                } 
+        shared_topk<node_type> topk(k, threshold);
+        wts.set_shared_topk(&topk);
+        std::atomic<uint64_t> search_space(0);
+        m_pool->submit(tasks.size(), [&](size_t task){
+            auto task_res = wts(tasks[task], k, ranked_and, profile, threshold);
+            if(profile) search_space += task_res.wt_search_space;
+        });
 
-                if ( !left_empty ) {
-                    push_node(pq, s.t_ptrs, std::get<0>(exp_v), std::get<0>(exp_r), pq_min, k);
-                } else{
-                    //std::cout<<"left_empty"<<std::endl;
-                }
-                if ( !right_empty ) {
-                    push_node(pq, s.t_ptrs, std::get<1>(exp_v), std::get<1>(exp_r), pq_min, k);
-                } else{
-                    //std::cout<<"right_empty"<<std::endl;
-                }
-            }
+        for (const auto& e : topk.sorted()){
+            res.list.emplace_back(e.doc_id, e.score);
         }
+        if(profile) res.wt_search_space = search_space;
         return res;
     }
 
+public:
+    /*! Stores the cost model of the direct evaluation, so that later
+     *  loads use it instead of calibrating it again (see load_direct_cost).
+     */
+    void store_direct_cost(sdsl::cache_config& cc)const{
+        store_to_cache(m_cost, direct_cost_key<t_wtd>(), cc);
+    }
+
     void load(sdsl::cache_config& cc){
         load_from_cache(m_csa, surf::KEY_CSA, cc, true);
         load_from_cache(m_wtd, surf::KEY_WTD, cc, true);
+        load_direct_cost(m_cost, m_wtd, cc);
         load_from_cache(m_df, surf::KEY_SADADF, cc, true);
         load_from_cache(m_docperm, surf::KEY_DOCPERM, cc); 
+        load_from_cache(m_tstats, surf::KEY_TERMSTATS, cc);
+        if ( tfb_type::enabled ){
+            load_from_cache(m_tfb, surf::KEY_TFBOUNDS, cc, true);
+        }
+        if ( rt_type::enabled ){
+            load_from_cache(m_rt, surf::KEY_RANGETABLE, cc, true);
+            m_rt_nodes = wt_level_nodes(m_wtd, m_rt.levels());
+        }
+        if ( topk_type::enabled ){
+            load_from_cache(m_topk, topk_lists_key<ranker_type>(), cc);
+        }
         m_ranker = ranker_type(cc);
     }
 
@@ -225,6 +312,10 @@ public:
         written_bytes += m_wtd.serialize(out, child, "WTD");
         written_bytes += m_df.serialize(out, child, "DF");
         written_bytes += m_docperm.serialize(out, child, "DOCPERM");
+        written_bytes += m_tfb.serialize(out, child, "TFBOUNDS");
+        written_bytes += m_rt.serialize(out, child, "RANGETABLE");
+        written_bytes += m_tstats.serialize(out, child, "TERMSTATS");
+        written_bytes += m_topk.serialize(out, child, "TOPKLISTS");
         structure_tree::add_size(child, written_bytes);
         return written_bytes;
     }
@@ -234,7 +325,12 @@ public:
         std::cout << sdsl::size_in_bytes(m_wtd) << ";"; // WTD^\ell 
         std::cout << sdsl::size_in_bytes(m_df) << ";";  // DF
         std::cout << 0 << ";"; // WTR^\ell
-        std::cout << sdsl::size_in_bytes(m_docperm) << std::endl;  // DOCPERM
+        std::cout << sdsl::size_in_bytes(m_docperm) << ";";  // DOCPERM
+        std::cout << sdsl::size_in_bytes(m_tstats) << ";";  // TERMSTATS
+        std::cout << sdsl::size_in_bytes(m_tfb) << ";";  // TFBOUNDS
+        std::cout << sdsl::size_in_bytes(m_topk) << ";";  // TOPKLISTS
+        std::cout << sdsl::size_in_bytes(m_rt) << ";";  // RANGETABLE
+        std::cout << sdsl::size_in_bytes(*this) << std::endl;  // total
 
     }
 
@@ -243,9 +339,12 @@ public:
 template<typename t_csa,
          typename t_wtd,
          typename t_df,
-         typename t_ranker
+         typename t_ranker,
+         typename t_tfb,
+         typename t_rt,
+         typename t_topk
         >
-void construct(idx_d<t_csa,t_wtd,t_df,t_ranker>& idx,
+void construct(idx_d<t_csa,t_wtd,t_df,t_ranker,t_tfb,t_rt,t_topk>& idx,
                const std::string&,
                sdsl::cache_config& cc, uint8_t num_bytes)
 {    
@@ -278,6 +377,47 @@ void construct(idx_d<t_csa,t_wtd,t_df,t_ranker>& idx,
         construct(df, "", cc, 0);
         store_to_cache(df, surf::KEY_SADADF, cc, true);
     }
+    cout<<"...TERMSTATS"<<endl;
+    if (!cache_file_exists(surf::KEY_TERMSTATS, cc))
+    {
+        t_csa csa;
+        t_df df;
+        load_from_cache(csa, surf::KEY_CSA, cc, true);
+        load_from_cache(df, surf::KEY_SADADF, cc, true);
+        auto no_map = [](uint64_t sp, uint64_t ep){ return std::make_pair(sp, ep); };
+        term_stats tstats(csa, df, false, no_map, false, no_map);
+        store_to_cache(tstats, surf::KEY_TERMSTATS, cc);
+    }
+    if ( t_tfb::enabled ){
+        cout<<"...TFBOUNDS"<<endl;
+        if (!cache_file_exists<t_tfb>(surf::KEY_TFBOUNDS, cc))
+        {
+            t_csa csa;
+            t_wtd wtd;
+            load_from_cache(csa, surf::KEY_CSA, cc, true);
+            load_from_cache(wtd, surf::KEY_WTD, cc, true);
+            int_vector_buffer<> darray(cache_file_name(surf::KEY_DARRAY, cc));
+            t_tfb tfb(csa, darray, wtd.max_level);
+            store_to_cache(tfb, surf::KEY_TFBOUNDS, cc, true);
+        }
+    }
+    if ( t_rt::enabled ){
+        cout<<"...RANGETABLE"<<endl;
+        if (!cache_file_exists<t_rt>(surf::KEY_RANGETABLE, cc))
+        {
+            t_csa csa;
+            t_wtd wtd;
+            load_from_cache(csa, surf::KEY_CSA, cc, true);
+            load_from_cache(wtd, surf::KEY_WTD, cc, true);
+            t_rt rt(csa, wtd);
+            cout << "range table: " << rt.size() << " terms" << endl;
+            store_to_cache(rt, surf::KEY_RANGETABLE, cc, true);
+        }
+    }
+    if ( t_topk::enabled ){
+        cout<<"...TOPKLISTS"<<endl;
+        construct_topk_lists<t_csa, t_df, t_ranker>(cc);
+    }
 }
 
 } // end namespace surf
@@ -5,9 +5,12 @@
 #include "surf/df_sada.hpp"
 #include "surf/rank_functions.hpp"
 #include "surf/idx_d.hpp"
+#include "surf/wt_search.hpp"
 #include "surf/idx_dr.hpp"
+#include "surf/term_stats.hpp"
 #include "surf/construct_col_len.hpp"
 #include "surf/construct_U.hpp"
+#include "surf/construct_R.hpp"
 #include <algorithm>
 #include <limits>
 #include <queue>
@@ -20,8 +23,19 @@ using range_type = sdsl::range_type;
 /*! Class idx_d1r1 consists of a 
  *   - CSA over the collection concatenation
  *   - document frequency structure
- *   - a WT over the reduced D array (only 1-phrases)
- *   - a WT over the (1-phrases) sorted repetition array
+ *   - a WT over the reduced D array (only t_depth-phrases)
+ *   - a WT over the (t_depth-phrases) sorted repetition array
+ *
+ *  The reduced D array U and the repetition array R are built for the
+ *  blocks of depth t_depth of the suffix tree (see construct_u and
+ *  construct_r). A term or phrase of at most t_depth tokens is a union
+ *  of blocks, so its frequency in a document is the number of
+ *  occurrences of the document in its U and R intervals. A longer
+ *  phrase gets the frequencies of its prefix of t_depth tokens, which
+ *  bound its own from above.
+ *
+ *  Optionally, the top-K lists of the heavy terms (t_topk=topk_lists)
+ *  answer single-term queries and give an initial threshold.
  */
 template<typename t_csa,
          typename t_df,
@@ -30,10 +44,11 @@ template<typename t_csa,
          typename t_ranker=rank_bm25<>,
          typename t_d1bv=sdsl::rrr_vector<63>,
          typename t_d1rank=typename t_d1bv::rank_1_type,
-         typename t_rbv=sdsl::rrr_vector<63>,
-         typename t_rrank=typename t_rbv::rank_1_type
+         uint64_t t_depth=1,
+         typename t_topk=no_topk_lists
          >
 class idx_d1r1{
+    static_assert(t_depth >= 1, "sorting depth of idx_d1r1 must be at least 1.");
 public:
     using size_type = sdsl::int_vector<>::size_type;
     typedef t_csa                        csa_type;
@@ -44,9 +59,9 @@ public:
     typedef typename wtr_type::node_type node2_type;
     typedef t_d1bv                       d1bv_type;
     typedef t_d1rank                     d1rank_type;
-    typedef t_rbv                        rbv_type;
-    typedef t_rrank                      rrank_type;
     typedef t_ranker                     ranker_type;
+    typedef t_topk                       topk_type;
+    static const uint64_t                depth = t_depth;
 private:
     csa_type    m_csa;
     df_type     m_df;
@@ -54,140 +69,91 @@ private:
     t_wtd1       m_wtd1;
     d1bv_type   m_d1bv;
     d1rank_type m_d1rank;
-    rbv_type    m_rbv;
-    rrank_type  m_rrank;
     doc_perm    m_docperm;
     ranker_type m_ranker;
-
-    using state_type = s_state2_t<node_type, node2_type>;
+    term_stats  m_tstats;
+    topk_type   m_topk;
+    mutable surf::term_cache m_term_cache;
 public:
 
+    //! Cache of the term ranges and document frequencies used by search.
+    const surf::term_cache& term_cache()const{
+        return m_term_cache;
+    }
+
     result search(const std::vector<query_token>& qry,size_t k,bool ranked_and = false,bool profile = false) const {
-        typedef std::priority_queue<state_type> pq_type;
+        if ( k == 0 ){
+            return result();
+        }
         std::vector<term_info> terms;
-        std::vector<term_info*> term_ptrs;
         std::vector<range_type> v_ranges; // ranges in wtd
         std::vector<range_type> w_ranges; // ranges in wtdup
-        result res;
 
         for (size_t i=0; i<qry.size(); ++i){
-            size_type sp=1, ep=0;
-            if ( backward_search(m_csa, 0, m_csa.size()-1, 
-                                qry[i].token_ids.begin(),
-                                qry[i].token_ids.end(),
-                                sp, ep) > 0 ) {
-
-//std::cout<<"[sp,ep]=["<<sp<<","<<ep<<"]"<<std::endl;
-                auto df_info = m_df(sp,ep);
-                auto f_Dt = std::get<0>(df_info); // document frequency
-                terms.emplace_back(qry[i].token_ids, qry[i].f_qt, sp, ep,  f_Dt);
-                sp = m_d1rank(sp);
-                ep = m_d1rank(ep+1)-1;
-//for(size_t k=sp; k<=ep; ++k){ std::cout<<".."<<m_wtd1[k]<<std::endl; }
-//std::cout<<std::endl;
-                //ep = sp+f_Dt-1;
-                v_ranges.emplace_back(sp, ep);
-                w_ranges.emplace_back(m_rrank(std::get<1>(df_info)),
-                                      m_rrank(std::get<2>(df_info)+1)-1);
-            }
-        }
-        term_ptrs.resize(terms.size()); 
-        for (size_type i=0; i<terms.size(); ++i){
-            term_ptrs[i] = &terms[i];
-        }
-        double initial_term_num = terms.size();
-
-        auto push_node = [this,&initial_term_num,&res,&profile,&ranked_and](pq_type& pq, state_type& s,node_type& v,std::vector<range_type>& r_v,
-                                node2_type& w, std::vector<range_type>& r_w){
-            auto min_idx = m_wtd1.sym(v) << (m_wtd1.max_level - v.level);  
-            auto min_doc_len = m_ranker.doc_length(m_docperm.len2id[min_idx]);
-            state_type t; // new state
-            t.v = v;
-            t.w = w;
-            t.score = initial_term_num * m_ranker.calc_doc_weight(min_doc_len);
-            bool eval = false;
-            bool is_leaf = m_wtd1.is_leaf(v);
-            for (size_t i = 0; i < r_v.size(); ++i){
-                if ( !empty(r_v[i]) ){
-                    eval = true;
-                    t.r_v.push_back(r_v[i]);
-                    t.r_w.push_back(r_w[i]);
-                    t.t_ptrs.push_back(s.t_ptrs[i]);
-                    auto score = m_ranker.calculate_docscore(
-                                 t.t_ptrs.back()->f_qt,
-                                 size(t.r_w.back())+1,
-                                 t.t_ptrs.back()->f_Dt,
-                                 t.t_ptrs.back()->F_Dt(),
-                                 min_doc_len,
-                                 is_leaf
-                               );
-                    t.score += score;
-                } else if ( ranked_and ) {
-                    return;
-                }
-            }
-            if (eval){ 
-//                std::cout << t << std::endl;
-                if (profile) res.wt_search_space++;
-                pq.emplace(t);       
+            term_range_info info;
+            uint64_t c;
+            range_type v_range;
+            bool in_tstats = m_tstats.lookup(m_csa, qry[i].token_ids, info, c);
+            if ( !in_tstats ) {
+                info = m_term_cache.lookup(m_csa, m_df, qry[i].token_ids);
             }
-        };
-
-        constexpr double max_score = std::numeric_limits<double>::max();
-        
-        pq_type pq;
-        size_type search_space=0;
-        pq.emplace(max_score, m_wtd1.root(), term_ptrs, v_ranges, m_wtr.root(), w_ranges);
-//        std::cout <<"\n" << pq.top() << std::endl;
-        if(profile) res.wt_search_space++;
-
-        while ( !pq.empty() and res.list.size() < k ) {
-            state_type s = pq.top();
-            pq.pop();
-            if ( m_wtd1.is_leaf(s.v) ){
-                res.list.emplace_back(m_docperm.len2id[m_wtd1.sym(s.v)], s.score);
-            } else {
-                auto exp_v = m_wtd1.expand(s.v);
-                auto exp_r_v = m_wtd1.expand(s.v, s.r_v);
-                auto exp_w = m_wtr.expand(s.w);
-                auto exp_r_w = m_wtr.expand(s.w, s.r_w);
-
-                if ( !m_wtd1.empty(std::get<0>(exp_v)) ) {
-                    push_node(pq, s, std::get<0>(exp_v), std::get<0>(exp_r_v), 
-                                     std::get<0>(exp_w), std::get<0>(exp_r_w));
+            if ( !info.empty() ) {
+                // SA interval of the token or of its prefix of t_depth tokens
+                uint64_t sp = info.sp, ep = info.ep;
+                if ( qry[i].token_ids.size() > t_depth ){
+                    std::vector<uint64_t> prefix(qry[i].token_ids.begin(),
+                                                 qry[i].token_ids.begin()+t_depth);
+                    auto prefix_info = m_term_cache.lookup(m_csa, m_df, prefix);
+                    sp = prefix_info.sp;
+                    ep = prefix_info.ep;
                 }
-                if ( !m_wtd1.empty(std::get<1>(exp_v)) ) {
-                    push_node(pq, s, std::get<1>(exp_v), std::get<1>(exp_r_v),
-                                     std::get<1>(exp_w), std::get<1>(exp_r_w));
+                if ( in_tstats ) {
+                    v_range = m_tstats.v_range(c);
+                } else {
+                    v_range = range_type(m_d1rank(sp), m_d1rank(ep+1)-1);
                 }
+                terms.emplace_back(qry[i].token_ids, qry[i].f_qt, info.sp, info.ep, info.f_Dt);
+                v_ranges.push_back(v_range);
+                // the repetitions of a block follow the ones of the blocks before it
+                w_ranges.push_back(range_type(sp - v_range.first, ep - v_range.second - 1));
             }
         }
-        return res;
+        // for depth 1 a token is a single block of U, in which a document
+        // occurs at most once; deeper tokens can span several blocks
+        auto tf = [](size_t, const node_type&, const wt_term_ranges& r){
+            return (t_depth == 1 ? 1 : size(r.v)) + size(r.w);
+        };
+        auto topk_qry = topk_terms(terms);
+        result res;
+        if ( terms.size() == 1 and m_topk.answer(m_ranker, topk_qry[0], k, profile, res) ){
+            return res;
+        }
+        auto search = make_wt_search(m_wtd1, m_wtr, m_docperm, m_ranker, terms, tf);
+        double threshold = m_topk.threshold(m_ranker, topk_qry, k, ranked_and);
+        return search(v_ranges, w_ranges, k, ranked_and, profile, threshold);
     }
 
     void load(sdsl::cache_config& cc){
         load_from_cache(m_csa, surf::KEY_CSA, cc, true);
         std::cout<<"m_csa.size()="<<m_csa.size()<<std::endl;
         load_from_cache(m_df, surf::KEY_SADADF, cc, true);
-    	std::string WTR_KEY = surf::KEY_WTR+"-"+std::to_string(1);
-        load_from_cache(m_wtr, WTR_KEY, cc, true);
+        load_from_cache(m_wtr, key_wtr(t_depth), cc, true);
         std::cerr<<"m_wtr.size()="<<m_wtr.size()<<std::endl;
         std::cerr<<"m_wtr.sigma()="<<m_wtr.sigma<<std::endl;
-        load_from_cache(m_wtd1, surf::KEY_WTU, cc, true);
+        load_from_cache(m_wtd1, key_depth(surf::KEY_WTU, t_depth), cc, true);
 //        load_from_cache(m_wtd1, surf::KEY_WTD, cc, true);
         std::cerr<<"m_wtd1.size()="<<m_wtd1.size()<<std::endl;
         std::cerr<<"m_wtd1.sigma()="<<m_wtd1.sigma<<std::endl;
-        load_from_cache(m_d1bv, surf::KEY_UMARK, cc, true);
+        load_from_cache(m_d1bv, key_depth(surf::KEY_UMARK, t_depth), cc, true);
         std::cerr<<"m_d1bv.size()="<<m_d1bv.size()<<std::endl;
-        load_from_cache(m_d1rank, surf::KEY_URANK, cc, true);
+        load_from_cache(m_d1rank, key_depth(surf::KEY_URANK, t_depth), cc, true);
         m_d1rank.set_vector(&m_d1bv);
         std::cerr<<"m_d1rank(m_d1bv.size())="<<m_d1rank(m_d1bv.size())<<std::endl;
-        load_from_cache(m_rbv, surf::KEY_DUPMARK, cc, true);
-        std::cerr<<"m_rbv.size()="<<m_rbv.size()<<std::endl;
-        load_from_cache(m_rrank, surf::KEY_DUPRANK, cc, true);
-        m_rrank.set_vector(&m_rbv);
-        std::cerr<<"m_rrank(m_rbv.size())="<<m_rrank(m_rbv.size())<<std::endl;
         load_from_cache(m_docperm, surf::KEY_DOCPERM, cc); 
+        load_from_cache(m_tstats, key_depth(surf::KEY_TERMSTATS_D1R1, t_depth), cc);
+        if ( topk_type::enabled ){
+            load_from_cache(m_topk, topk_lists_key<ranker_type>(), cc);
+        }
         m_ranker = ranker_type(cc);
     }
 
@@ -200,9 +166,9 @@ public:
         written_bytes += m_wtd1.serialize(out, child, "WTD1");
         written_bytes += m_d1bv.serialize(out, child, "D1_BV");
         written_bytes += m_d1rank.serialize(out, child, "D1_RANK");
-        written_bytes += m_rbv.serialize(out, child, "R_BV");
-        written_bytes += m_rrank.serialize(out, child, "R_RANK");
         written_bytes += m_docperm.serialize(out, child, "DOCPERM");
+        written_bytes += m_tstats.serialize(out, child, "TERMSTATS");
+        written_bytes += m_topk.serialize(out, child, "TOPKLISTS");
         structure_tree::add_size(child, written_bytes);
         return written_bytes;
     }
@@ -214,11 +180,13 @@ public:
                    + sdsl::size_in_bytes(m_d1rank) 
                   << ";"; // WTD^\ell 
         std::cout << sdsl::size_in_bytes(m_df) << ";";  // DF
-        std::cout << sdsl::size_in_bytes(m_wtr) 
-                   + sdsl::size_in_bytes(m_rbv) 
-                   + sdsl::size_in_bytes(m_rrank) 
-                  << ";"; // WTR^\ell
-        std::cout << sdsl::size_in_bytes(m_docperm) << std::endl;  // DOCPERM
+        std::cout << sdsl::size_in_bytes(m_wtr) << ";"; // WTR^\ell
+        std::cout << sdsl::size_in_bytes(m_docperm) << ";";  // DOCPERM
+        std::cout << sdsl::size_in_bytes(m_tstats) << ";";  // TERMSTATS
+        std::cout << 0 << ";";  // TFBOUNDS
+        std::cout << sdsl::size_in_bytes(m_topk) << ";";  // TOPKLISTS
+        std::cout << 0 << ";";  // RANGETABLE
+        std::cout << sdsl::size_in_bytes(*this) << std::endl;  // total
     }
 
 };
@@ -230,9 +198,9 @@ template<typename t_csa,
          typename t_ranker,
          typename t_d1bv,
          typename t_d1rank,
-         typename t_rbv,
-         typename t_rrank>
-void construct(idx_d1r1<t_csa,t_df,t_wtr,t_wtd1, t_ranker, t_d1bv, t_d1rank, t_rbv, t_rrank>& idx,
+         uint64_t t_depth,
+         typename t_topk>
+void construct(idx_d1r1<t_csa,t_df,t_wtr,t_wtd1, t_ranker, t_d1bv, t_d1rank, t_depth, t_topk>& idx,
                const std::string&,
                sdsl::cache_config& cc, uint8_t num_bytes)
 {    
@@ -263,77 +231,38 @@ void construct(idx_d1r1<t_csa,t_df,t_wtr,t_wtd1, t_ranker, t_d1bv, t_d1rank, t_r
         cout << "wtr.size() = " << wtr.size() << endl;
         cout << "wtr.sigma = " << wtr.sigma << endl;
     }
+    const uint64_t depth=t_depth; // depth of the blocks of U and R
+    const std::string U_KEY = key_depth(surf::KEY_U, depth);
+    const std::string UMARK_KEY = key_depth(surf::KEY_UMARK, depth);
+    const std::string URANK_KEY = key_depth(surf::KEY_URANK, depth);
+    const std::string WTU_KEY = key_depth(surf::KEY_WTU, depth);
+    const std::string TERMSTATS_KEY = key_depth(surf::KEY_TERMSTATS_D1R1, depth);
     cout<<"...U and Umark"<<endl;
-    if (!cache_file_exists(surf::KEY_U,cc) or !cache_file_exists(surf::KEY_UMARK,cc)){
-        construct_u<t_df>(cc);
+    if (!cache_file_exists(U_KEY,cc) or !cache_file_exists(UMARK_KEY,cc)){
+        construct_u<t_df>(cc, depth);
     }
     cout<<"...WTU"<<endl;
-    if (!cache_file_exists<t_wtd1>(surf::KEY_WTU, cc) ){
+    if (!cache_file_exists<t_wtd1>(WTU_KEY, cc) ){
         t_wtd1 wtd1;
-        construct(wtd1, cache_file_name(surf::KEY_U, cc), cc);
+        construct(wtd1, cache_file_name(U_KEY, cc), cc);
         cout << "wtd1.size() = " << wtd1.size() << endl;
         cout << "wtd1.sigma = " << wtd1.sigma << endl;
-        store_to_cache(wtd1, surf::KEY_WTU, cc, true);
+        store_to_cache(wtd1, WTU_KEY, cc, true);
     }
     cout<<"...D1_BV"<<endl;
-    if (!cache_file_exists<t_d1bv>(surf::KEY_UMARK, cc) ){
+    if (!cache_file_exists<t_d1bv>(UMARK_KEY, cc) ){
         bit_vector bv;
-        load_from_cache(bv, surf::KEY_UMARK, cc);
+        load_from_cache(bv, UMARK_KEY, cc);
         t_d1bv d1bv(bv);
-        store_to_cache(d1bv, surf::KEY_UMARK, cc, true);
+        store_to_cache(d1bv, UMARK_KEY, cc, true);
         t_d1rank d1rank(&d1bv);
-        store_to_cache(d1rank, surf::KEY_URANK, cc, true);
+        store_to_cache(d1rank, URANK_KEY, cc, true);
     }
     cout<<"...WTR2"<<endl;
-    const uint64_t depth=1; // depth of sorting in the repetition structure
-    std::string R_KEY = surf::KEY_R+"-"+to_string(depth);
-    std::string WTR_KEY = surf::KEY_WTR+"-"+to_string(depth);
+    std::string R_KEY = key_r(depth);
+    std::string WTR_KEY = key_wtr(depth);
     if (!cache_file_exists<t_wtr>(WTR_KEY,cc)){
-        string dup2_file = cache_file_name(surf::KEY_DUP2,cc);
-        if (!cache_file_exists(surf::KEY_DUP2,cc)){
-            construct_dup2<t_df>(cc); // construct DUP2 and DUPMARK
-        }
-        if (!cache_file_exists<t_rbv>(surf::KEY_DUPMARK, cc) ){
-            bit_vector bv;
-            load_from_cache(bv, surf::KEY_DUPMARK, cc);
-            t_rbv rbv(bv);
-            store_to_cache(rbv, surf::KEY_DUPMARK, cc, true);
-            t_rrank rrank(&rbv);
-            store_to_cache(rrank, surf::KEY_DUPRANK, cc, true);
-        }
-        if ( !cache_file_exists(R_KEY, cc) ) {
-            std::cout<<"generate "<<R_KEY<<" file"<<std::endl;
-            cout<<".........load df"<<endl;
-            t_df df;
-            load_from_cache(df, surf::KEY_SADADF, cc, true);
-            cout<<".........load cst"<<endl;
-            using cst_type =  typename t_df::cst_type;
-            cst_type cst;
-            load_from_file(cst, cache_file_name<cst_type>(surf::KEY_TMPCST, cc));
-            cout<<".........cst.size()="<<cst.size()<<endl;
-            int_vector_buffer<> dup(cache_file_name(surf::KEY_DUP, cc));
-            cout<<"dup.size()="<<dup.size()<<" dup.width()="<<(int)dup.width()<<endl;
-            int_vector_buffer<> R(cache_file_name(R_KEY,cc), 
-                                  std::ios::out, 1024*1024, dup.width());
-            cout<<"R intialized"<<endl;
-            auto root = cst.root();
-            auto left_most_leaf = cst.select_leaf(1);
-            for (const auto& v : cst.children(root) ){
-                if ( v == left_most_leaf )
-                    continue;
-                auto lb = cst.lb(v);
-                auto rb = cst.rb(v);
-                auto df_info = df(lb, rb);
-                std::vector<uint64_t> buf;
-                for (uint64_t i = std::get<1>(df_info); i <= std::get<2>(df_info); ++i) {
-                    buf.push_back(dup[i]); 
-                }
-                std::sort(buf.begin(), buf.end());
-                for (size_t i=0; i < buf.size(); ++i){
-                    R.push_back(buf[i]);
-                }
-            }
-        }
+        construct_r<t_df>(cc, depth);
         {
             cout<<"......generate WT"<<endl;
             t_wtr wtr2;
@@ -341,6 +270,29 @@ void construct(idx_d1r1<t_csa,t_df,t_wtr,t_wtd1, t_ranker, t_d1bv, t_d1rank, t_r
             store_to_cache(wtr2, WTR_KEY,cc,true);
         }
     }
+    cout<<"...TERMSTATS"<<endl;
+    if (!cache_file_exists(TERMSTATS_KEY, cc))
+    {
+        t_csa csa;
+        t_df df;
+        t_d1bv d1bv;
+        t_d1rank d1rank;
+        load_from_cache(csa, surf::KEY_CSA, cc, true);
+        load_from_cache(df, surf::KEY_SADADF, cc, true);
+        load_from_cache(d1bv, UMARK_KEY, cc, true);
+        load_from_cache(d1rank, URANK_KEY, cc, true);
+        d1rank.set_vector(&d1bv);
+        auto d1_map = [&d1rank](uint64_t sp, uint64_t ep){
+            return std::make_pair(d1rank(sp), d1rank(ep+1)-1);
+        };
+        // the R interval follows from the SA and the U interval
+        term_stats tstats(csa, df, false, d1_map, true, d1_map);
+        store_to_cache(tstats, TERMSTATS_KEY, cc);
+    }
+    if ( t_topk::enabled ){
+        cout<<"...TOPKLISTS"<<endl;
+        construct_topk_lists<t_csa, t_df, t_ranker>(cc);
+    }
 }
 
 } // end namespace surf
@@ -5,9 +5,13 @@
 #include "surf/df_sada.hpp"
 #include "surf/rank_functions.hpp"
 #include "surf/idx_d.hpp"
+#include "surf/wt_search.hpp"
 #include "surf/idx_dr.hpp"
+#include "surf/term_stats.hpp"
 #include "surf/construct_col_len.hpp"
 #include "surf/construct_U.hpp"
+#include "surf/construct_R.hpp"
+#include "surf/lcp_intervals.hpp"
 #include <algorithm>
 #include <limits>
 #include <queue>
@@ -23,6 +27,7 @@ using range_type = sdsl::range_type;
  *   - a WT over the reduced D array (only 1-phrases)
  *   - a WT over the (1-phrases) sorted repetition array
  *   - max term frequency for words
+ *   - optionally, the top-K lists of the heavy terms (t_topk=topk_lists)
  */
 template<typename t_csa,
          typename t_df,
@@ -32,7 +37,8 @@ template<typename t_csa,
          typename t_d1bv=sdsl::rrr_vector<63>,
          typename t_d1rank=typename t_d1bv::rank_1_type,
          typename t_rbv=sdsl::rrr_vector<63>,
-         typename t_rrank=typename t_rbv::rank_1_type
+         typename t_rrank=typename t_rbv::rank_1_type,
+         typename t_topk=no_topk_lists
          >
 class idx_d1r1mtf{
 public:
@@ -48,6 +54,7 @@ public:
     typedef t_rbv                        rbv_type;
     typedef t_rrank                      rrank_type;
     typedef t_ranker                     ranker_type;
+    typedef t_topk                       topk_type;
 private:
     csa_type    m_csa;
     df_type     m_df;
@@ -60,114 +67,64 @@ private:
     doc_perm    m_docperm;
     sdsl::int_vector<> m_mtf;
     ranker_type m_ranker;
-
-    using state_type = s_state2_t<node_type, node2_type>;
+    term_stats  m_tstats;
+    topk_type   m_topk;
+    mutable surf::term_cache m_term_cache;
 public:
 
-    result search(const std::vector<query_token>& qry,size_t k,bool ranked_and = false,bool profile = false) {
-        typedef std::priority_queue<state_type> pq_type;
+    //! Cache of the term ranges and document frequencies used by search.
+    const surf::term_cache& term_cache()const{
+        return m_term_cache;
+    }
+
+    result search(const std::vector<query_token>& qry,size_t k,bool ranked_and = false,bool profile = false) const {
+        if ( k == 0 ){
+            return result();
+        }
         std::vector<term_info> terms;
-        std::vector<term_info*> term_ptrs;
         std::vector<range_type> v_ranges; // ranges in wtd
         std::vector<range_type> w_ranges; // ranges in wtdup
-        result res;
 
         for (size_t i=0; i<qry.size(); ++i){
-            size_type sp=1, ep=0;
-            if ( backward_search(m_csa, 0, m_csa.size()-1, 
-                                qry[i].token_ids.begin(),
-                                qry[i].token_ids.end(),
-                                sp, ep) > 0 ) {
-//std::cout<<"[sp,ep]=["<<sp<<","<<ep<<"]"<<std::endl;
-                auto df_info = m_df(sp,ep);
-                auto f_Dt = std::get<0>(df_info); // document frequency
-                terms.emplace_back(qry[i].token_ids, qry[i].f_qt, sp, ep,  f_Dt);
-                sp = m_d1rank(sp);
-                ep = m_d1rank(ep+1)-1;
-//for(size_t k=sp; k<=ep; ++k){ std::cout<<".."<<m_wtd1[k]<<std::endl; }
-//std::cout<<std::endl;
-                v_ranges.emplace_back(sp, ep);
-                w_ranges.emplace_back(m_rrank(std::get<1>(df_info)),
-                                      m_rrank(std::get<2>(df_info)+1)-1);
-            }
-        }
-        term_ptrs.resize(terms.size()); 
-        for (size_type i=0; i<terms.size(); ++i){
-            term_ptrs[i] = &terms[i];
-        }
-        double initial_term_num = terms.size();
-
-        auto push_node = [this,&initial_term_num,&res,&profile,&ranked_and](pq_type& pq, state_type& s,node_type& v,std::vector<range_type>& r_v,
-                                node2_type& w, std::vector<range_type>& r_w){
-            auto min_idx = m_wtd1.sym(v) << (m_wtd1.max_level - v.level);  
-            auto min_doc_len = m_ranker.doc_length(m_docperm.len2id[min_idx]);
-            state_type t; // new state
-            t.v = v;
-            t.w = w;
-            t.score = initial_term_num * m_ranker.calc_doc_weight(min_doc_len);
-            bool eval = false;
-            for (size_t i = 0; i < r_v.size(); ++i){
-                if ( !empty(r_v[i]) ){
-                    eval = true;
-                    t.r_v.push_back(r_v[i]);
-                    t.r_w.push_back(r_w[i]);
-                    t.t_ptrs.push_back(s.t_ptrs[i]);
-                    auto score = m_ranker.calculate_docscore(
-                                 t.t_ptrs.back()->f_qt,
-                                 std::min(size(t.r_w.back())+1, (uint64_t)(m_mtf[t.t_ptrs.back()->t[0]]) ),
-                                 //size(t.r_w.back())+1,
-                                 t.t_ptrs.back()->f_Dt,
-                                 t.t_ptrs.back()->F_Dt(),
-                                 min_doc_len,
-                                 m_wtd1.is_leaf(v)
-                               );
-                    t.score += score;
-                } else if ( ranked_and ) {
-                    return;
+            term_range_info info;
+            uint64_t c;
+            range_type v_range, w_range;
+            if ( m_tstats.lookup(m_csa, qry[i].token_ids, info, c) ) {
+                if ( !info.empty() ) {
+                    v_range = m_tstats.v_range(c);
+                    w_range = m_tstats.w_range(c);
                 }
-            }
-            if (eval){ 
-                if (profile) res.wt_search_space++;
-                pq.emplace(t);       
-            }
-        };
-
-        constexpr double max_score = std::numeric_limits<double>::max();
-        
-        pq_type pq;
-        size_type search_space=0;
-        pq.emplace(max_score, m_wtd1.root(), term_ptrs, v_ranges, m_wtr.root(), w_ranges);
-        if(profile) res.wt_search_space++;
-
-        while ( !pq.empty() and res.list.size() < k ) {
-            state_type s = pq.top();
-            pq.pop();
-            if ( m_wtd1.is_leaf(s.v) ){
-                res.list.emplace_back(m_docperm.len2id[m_wtd1.sym(s.v)], s.score);
             } else {
-                auto exp_v = m_wtd1.expand(s.v);
-                auto exp_r_v = m_wtd1.expand(s.v, s.r_v);
-                auto exp_w = m_wtr.expand(s.w);
-                auto exp_r_w = m_wtr.expand(s.w, s.r_w);
-
-                if ( !m_wtd1.empty(std::get<0>(exp_v)) ) {
-                    push_node(pq, s, std::get<0>(exp_v), std::get<0>(exp_r_v), 
-                                     std::get<0>(exp_w), std::get<0>(exp_r_w));
-                }
-                if ( !m_wtd1.empty(std::get<1>(exp_v)) ) {
-                    push_node(pq, s, std::get<1>(exp_v), std::get<1>(exp_r_v),
-                                     std::get<1>(exp_w), std::get<1>(exp_r_w));
+                info = m_term_cache.lookup(m_csa, m_df, qry[i].token_ids);
+                if ( !info.empty() ) {
+                    v_range = range_type(m_d1rank(info.sp), m_d1rank(info.ep+1)-1);
+                    w_range = range_type(m_rrank(info.dup_sp),
+                                         m_rrank(info.dup_ep+1)-1);
                 }
             }
+            if ( !info.empty() ) {
+                terms.emplace_back(qry[i].token_ids, qry[i].f_qt, info.sp, info.ep, info.f_Dt);
+                v_ranges.push_back(v_range);
+                w_ranges.push_back(w_range);
+            }
+        }
+        auto tf = [this,&terms](size_t i, const node_type&, const wt_term_ranges& r){
+            return std::min(size(r.w)+1, (uint64_t)(m_mtf[terms[i].t[0]]));
+        };
+        auto topk_qry = topk_terms(terms);
+        result res;
+        if ( terms.size() == 1 and m_topk.answer(m_ranker, topk_qry[0], k, profile, res) ){
+            return res;
         }
-        return res;
+        auto search = make_wt_search(m_wtd1, m_wtr, m_docperm, m_ranker, terms, tf);
+        double threshold = m_topk.threshold(m_ranker, topk_qry, k, ranked_and);
+        return search(v_ranges, w_ranges, k, ranked_and, profile, threshold);
     }
 
     void load(sdsl::cache_config& cc){
         load_from_cache(m_csa, surf::KEY_CSA, cc, true);
         load_from_cache(m_df, surf::KEY_SADADF, cc, true);
-    	std::string WTR_KEY = surf::KEY_WTR+"-"+std::to_string(1);
-        load_from_cache(m_wtr, WTR_KEY, cc, true);
+        load_from_cache(m_wtr, key_wtr(1), cc, true);
         std::cerr<<"m_wtr.size()="<<m_wtr.size()<<std::endl;
         std::cerr<<"m_wtr.sigma()="<<m_wtr.sigma<<std::endl;
         load_from_cache(m_wtd1, surf::KEY_WTU, cc, true);
@@ -183,6 +140,10 @@ public:
         m_rrank.set_vector(&m_rbv);
         std::cerr<<"m_rrank(m_rbv.size())="<<m_rrank(m_rbv.size())<<std::endl;
         load_from_cache(m_docperm, surf::KEY_DOCPERM, cc); 
+        load_from_cache(m_tstats, surf::KEY_TERMSTATS_D1R1MTF, cc);
+        if ( topk_type::enabled ){
+            load_from_cache(m_topk, topk_lists_key<ranker_type>(), cc);
+        }
         std::cerr<<"DOC_PERM loaded"<<std::endl;
         load_from_cache(m_mtf, surf::KEY_MAXTF, cc); 
         std::cerr<<"MAXTF loaded"<<std::endl;
@@ -205,6 +166,8 @@ public:
         written_bytes += m_rbv.serialize(out, child, "R_BV");
         written_bytes += m_rrank.serialize(out, child, "R_RANK");
         written_bytes += m_docperm.serialize(out, child, "DOCPERM");
+        written_bytes += m_tstats.serialize(out, child, "TERMSTATS");
+        written_bytes += m_topk.serialize(out, child, "TOPKLISTS");
         written_bytes += m_mtf.serialize(out, child, "MTF");
         structure_tree::add_size(child, written_bytes);
         return written_bytes;
@@ -221,7 +184,12 @@ public:
                    + sdsl::size_in_bytes(m_rbv) 
                    + sdsl::size_in_bytes(m_rrank) 
                   << ";"; // WTR^\ell
-        std::cout << sdsl::size_in_bytes(m_docperm) << std::endl;  // DOCPERM
+        std::cout << sdsl::size_in_bytes(m_docperm) << ";";  // DOCPERM
+        std::cout << sdsl::size_in_bytes(m_tstats) << ";";  // TERMSTATS
+        std::cout << 0 << ";";  // TFBOUNDS
+        std::cout << sdsl::size_in_bytes(m_topk) << ";";  // TOPKLISTS
+        std::cout << 0 << ";";  // RANGETABLE
+        std::cout << sdsl::size_in_bytes(*this) << std::endl;  // total
     }
 
 };
@@ -234,8 +202,9 @@ template<typename t_csa,
          typename t_d1bv,
          typename t_d1rank,
          typename t_rbv,
-         typename t_rrank>
-void construct(idx_d1r1mtf<t_csa,t_df,t_wtr,t_wtd1, t_ranker, t_d1bv, t_d1rank, t_rbv, t_rrank>& idx,
+         typename t_rrank,
+         typename t_topk>
+void construct(idx_d1r1mtf<t_csa,t_df,t_wtr,t_wtd1, t_ranker, t_d1bv, t_d1rank, t_rbv, t_rrank, t_topk>& idx,
                const std::string&,
                sdsl::cache_config& cc, uint8_t num_bytes)
 {    
@@ -289,8 +258,8 @@ void construct(idx_d1r1mtf<t_csa,t_df,t_wtr,t_wtd1, t_ranker, t_d1bv, t_d1rank,
     }
     cout<<"...WTR2"<<endl;
     const uint64_t depth=1; // depth of sorting in the repetition structure
-    std::string R_KEY = surf::KEY_R+"-"+to_string(depth);
-    std::string WTR_KEY = surf::KEY_WTR+"-"+to_string(depth);
+    std::string R_KEY = key_r(depth);
+    std::string WTR_KEY = key_wtr(depth);
     if (!cache_file_exists<t_wtr>(WTR_KEY,cc)){
         string dup2_file = cache_file_name(surf::KEY_DUP2,cc);
         if (!cache_file_exists(surf::KEY_DUP2,cc)){
@@ -304,39 +273,7 @@ void construct(idx_d1r1mtf<t_csa,t_df,t_wtr,t_wtd1, t_ranker, t_d1bv, t_d1rank,
             t_rrank rrank(&rbv);
             store_to_cache(rrank, surf::KEY_DUPRANK, cc, true);
         }
-        if ( !cache_file_exists(R_KEY, cc) ) {
-            std::cout<<"generate "<<R_KEY<<" file"<<std::endl;
-            cout<<".........load df"<<endl;
-            t_df df;
-            load_from_cache(df, surf::KEY_SADADF, cc, true);
-            cout<<".........load cst"<<endl;
-            using cst_type =  typename t_df::cst_type;
-            cst_type cst;
-            load_from_file(cst, cache_file_name<cst_type>(surf::KEY_TMPCST, cc));
-            cout<<".........cst.size()="<<cst.size()<<endl;
-            int_vector_buffer<> dup(cache_file_name(surf::KEY_DUP, cc));
-            cout<<"dup.size()="<<dup.size()<<" dup.width()="<<(int)dup.width()<<endl;
-            int_vector_buffer<> R(cache_file_name(R_KEY,cc), 
-                                  std::ios::out, 1024*1024, dup.width());
-            cout<<"R intialized"<<endl;
-            auto root = cst.root();
-            auto left_most_leaf = cst.select_leaf(1);
-            for (const auto& v : cst.children(root) ){
-                if ( v == left_most_leaf )
-                    continue;
-                auto lb = cst.lb(v);
-                auto rb = cst.rb(v);
-                auto df_info = df(lb, rb);
-                std::vector<uint64_t> buf;
-                for (uint64_t i = std::get<1>(df_info); i <= std::get<2>(df_info); ++i) {
-                    buf.push_back(dup[i]); 
-                }
-                std::sort(buf.begin(), buf.end());
-                for (size_t i=0; i < buf.size(); ++i){
-                    R.push_back(buf[i]);
-                }
-            }
-        }
+        construct_r<t_df>(cc, depth);
         {
             cout<<"......generate WT"<<endl;
             t_wtr wtr2;
@@ -347,21 +284,12 @@ void construct(idx_d1r1mtf<t_csa,t_df,t_wtr,t_wtd1, t_ranker, t_d1bv, t_d1rank,
 
     if (!cache_file_exists(KEY_MAXTF,cc)){
         std::cout<<"generate "<<KEY_MAXTF<<" file"<<std::endl;
-        cout<<".........load cst"<<endl;
-        using cst_type =  typename t_df::cst_type;
-        cst_type cst;
-        load_from_file(cst, cache_file_name<cst_type>(surf::KEY_TMPCST, cc));
-        cout<<".........cst.size()="<<cst.size()<<endl;
+        int_vector_buffer<> lcp(cache_file_name(conf::KEY_LCP, cc));
+        cout<<".........lcp.size()="<<lcp.size()<<endl;
         int_vector_buffer<> darray(cache_file_name(surf::KEY_DARRAY, cc));
         cout<<"darray.size()="<<darray.size()<<" darray.width()="<<(int)darray.width()<<endl;
-        int_vector<> maxft(cst.degree(cst.root()), 0, bits::hi(cst.size())+1);
-        cout<<"maxft.size()="<<maxft.size()<<endl;
-
-        auto root = cst.root();
-        auto v = cst.select_leaf(1);
-        for (uint64_t j=0; v != root; ++j, v = cst.sibling(v)){
-            auto lb = cst.lb(v);
-            auto rb = cst.rb(v);
+        std::vector<uint64_t> maxft_buf;
+        root_children(lcp, [&](uint64_t lb, uint64_t rb){
             std::vector<uint64_t> buf(rb-lb+1,0);
             for (uint64_t i = lb; i <= rb; ++i) { buf[i-lb] = darray[i]; }
             std::sort(buf.begin(), buf.end());
@@ -375,11 +303,44 @@ void construct(idx_d1r1mtf<t_csa,t_df,t_wtr,t_wtd1, t_ranker, t_d1bv, t_d1rank,
                     x = 1;
                 }
             }
-            maxft[j] = maxx;
-        }
+            maxft_buf.push_back(maxx);
+        });
+        int_vector<> maxft(maxft_buf.size(), 0, bits::hi(lcp.size())+1);
+        std::copy(maxft_buf.begin(), maxft_buf.end(), maxft.begin());
+        cout<<"maxft.size()="<<maxft.size()<<endl;
         util::bit_compress(maxft);
         store_to_cache(maxft, KEY_MAXTF, cc);
     }
+    cout<<"...TERMSTATS"<<endl;
+    if (!cache_file_exists(surf::KEY_TERMSTATS_D1R1MTF, cc))
+    {
+        t_csa csa;
+        t_df df;
+        t_d1bv d1bv;
+        t_d1rank d1rank;
+        t_rbv rbv;
+        t_rrank rrank;
+        load_from_cache(csa, surf::KEY_CSA, cc, true);
+        load_from_cache(df, surf::KEY_SADADF, cc, true);
+        load_from_cache(d1bv, surf::KEY_UMARK, cc, true);
+        load_from_cache(d1rank, surf::KEY_URANK, cc, true);
+        d1rank.set_vector(&d1bv);
+        load_from_cache(rbv, surf::KEY_DUPMARK, cc, true);
+        load_from_cache(rrank, surf::KEY_DUPRANK, cc, true);
+        rrank.set_vector(&rbv);
+        auto r_map = [&rrank](uint64_t sp, uint64_t ep){
+            return std::make_pair(rrank(sp), rrank(ep+1)-1);
+        };
+        auto d1_map = [&d1rank](uint64_t sp, uint64_t ep){
+            return std::make_pair(d1rank(sp), d1rank(ep+1)-1);
+        };
+        term_stats tstats(csa, df, true, r_map, true, d1_map);
+        store_to_cache(tstats, surf::KEY_TERMSTATS_D1R1MTF, cc);
+    }
+    if ( t_topk::enabled ){
+        cout<<"...TOPKLISTS"<<endl;
+        construct_topk_lists<t_csa, t_df, t_ranker>(cc);
+    }
 }
 
 } // end namespace surf
@@ -5,6 +5,8 @@
 #include "surf/df_sada.hpp"
 #include "surf/rank_functions.hpp"
 #include "surf/idx_d.hpp"
+#include "surf/term_stats.hpp"
+#include "surf/wt_search.hpp"
 #include "surf/construct_col_len.hpp"
 #include "surf/construct_DUP2.hpp"
 #include <algorithm>
@@ -16,58 +18,12 @@ namespace surf{
 using range_type = sdsl::range_type;
 
 
-template<typename t_wtd_node, typename t_wtr_node>
-struct s_state2_t{
-    double score;
-    t_wtd_node v; // node in document array wavelet tree
-    std::vector<term_info*> t_ptrs; // pointers to term_info array
-    std::vector<range_type> r_v; // ranges in v
-    t_wtr_node w; // node in repetition array wavelet tree
-    std::vector<range_type> r_w; // ranges in w
-
-    s_state2_t() = default;
-
-    s_state2_t(double score, const t_wtd_node& v, 
-              const std::vector<term_info*>& t_ptrs,
-              const std::vector<range_type>& r_v,
-              const t_wtr_node& w,
-              const std::vector<range_type>& r_w):
-        score(score), v(v), t_ptrs(t_ptrs),
-        r_v(r_v),w(w),r_w(r_w)
-    {}
-
-    s_state2_t(s_state2_t&&) = default;
-    s_state2_t(const s_state2_t&) = default;
-
-    s_state2_t& operator=(s_state2_t&&) = default;
-    s_state2_t& operator=(const s_state2_t&) = default;
-
-    bool operator<(const s_state2_t& s)const{
-        if ( score != s.score ){
-            return score < s.score;
-        }
-        return v < s.v;
-    }
-};
-
-
-template<typename t_wtd_node, typename t_wtr_node>
-inline std::ostream& operator<<(std::ostream& os, const s_state2_t<t_wtd_node, t_wtr_node>& state)
-{
-    os << state.v.level << "-("<<state.score<<") ";
-    for(auto x : state.r_v){ os<<"["<<x.first<<","<<x.second<<"]:"<<x.second-x.first+1<<" "; }
-    os << "|";
-    for(auto x : state.r_w){ os<<"["<<x.first<<","<<x.second<<"]:"<<x.second-x.first+1<<" "; }
-    return os;
-}
-
-
-
 /*! Class idx_dr consists of a 
  *   - CSA over the collection concatenation
  *   - document frequency structure
  *   - a WT over the D array
  *   - a WT over the repetition array
+ *   - optionally, the top-K lists of the heavy terms (t_topk=topk_lists)
  */
 template<typename t_csa,
          typename t_df,
@@ -75,7 +31,8 @@ template<typename t_csa,
          typename t_wtr,
          typename t_ranker=rank_bm25<>,
          typename t_rbv=sdsl::rrr_vector<63>,
-         typename t_rrank=typename t_rbv::rank_1_type>
+         typename t_rrank=typename t_rbv::rank_1_type,
+         typename t_topk=no_topk_lists>
 class idx_dr{
 public:
     using size_type = sdsl::int_vector<>::size_type;
@@ -88,6 +45,7 @@ public:
     typedef t_rbv                        rbv_type;
     typedef t_rrank                      rrank_type;
     typedef t_ranker                     ranker_type;
+    typedef t_topk                       topk_type;
 public:
     csa_type    m_csa;
     df_type     m_df;
@@ -97,110 +55,74 @@ public:
     rrank_type  m_rrank;
     doc_perm    m_docperm;
     ranker_type m_ranker;
-
-    using state_type = s_state2_t<node_type, node2_type>;
+    term_stats  m_tstats;
+    topk_type   m_topk;
+    mutable surf::term_cache m_term_cache;
+    direct_cost_model m_cost;
 public:
 
+    //! Cache of the term ranges and document frequencies used by search.
+    const surf::term_cache& term_cache()const{
+        return m_term_cache;
+    }
+
     result search(const std::vector<query_token>& qry,size_t k,bool ranked_and = false,bool profile = false) const {
-        typedef std::priority_queue<state_type> pq_type;
+        if ( k == 0 ){
+            return result();
+        }
         std::vector<term_info> terms;
-        std::vector<term_info*> term_ptrs;
         std::vector<range_type> v_ranges; // ranges in wtd
         std::vector<range_type> w_ranges; // ranges in wtdup
-        result res;
+        uint64_t occ = 0;                 // total size of the ranges in wtd
 
         for (size_t i=0; i<qry.size(); ++i){
-            size_type sp=1, ep=0;
-            if ( backward_search(m_csa, 0, m_csa.size()-1, 
-                                qry[i].token_ids.begin(),
-                                qry[i].token_ids.end(),
-                                sp, ep) > 0 ) {
-                auto df_info = m_df(sp,ep);
-//std::cout<<"[sp,ep]=["<<sp<<","<<ep<<"]"<<std::endl;
-                auto f_Dt = std::get<0>(df_info); // document frequency
-                terms.emplace_back(qry[i].token_ids, qry[i].f_qt, sp, ep,  f_Dt);
-//for(size_t k=sp; k<=ep; ++k){ std::cout<<".."<<m_wtd[k]<<std::endl; }
-//std::cout<<std::endl;
-                v_ranges.emplace_back(sp, ep);
-                w_ranges.emplace_back(m_rrank(std::get<1>(df_info)),
-                                      m_rrank(std::get<2>(df_info)+1)-1);
-
-            }
-        }
-        term_ptrs.resize(terms.size()); 
-        for (size_type i=0; i<terms.size(); ++i){
-            term_ptrs[i] = &terms[i];
-        }
-        double initial_term_num = terms.size();
-
-        auto push_node = [this,&initial_term_num,&res,&profile,&ranked_and](pq_type& pq, state_type& s,node_type& v,std::vector<range_type>& r_v,
-                                node2_type& w, std::vector<range_type>& r_w){
-            auto min_idx = m_wtd.sym(v) << (m_wtd.max_level - v.level);  
-            auto min_doc_len = m_ranker.doc_length(m_docperm.len2id[min_idx]);
-            state_type t; // new state
-            t.v = v;
-            t.w = w;
-            t.score = initial_term_num * m_ranker.calc_doc_weight(min_doc_len);
-            bool eval = false;
-            bool is_leaf = m_wtd.is_leaf(v);
-            for (size_t i = 0; i < r_v.size(); ++i){
-                if ( !empty(r_v[i]) ){
-                    eval = true;
-                    t.r_v.push_back(r_v[i]);
-                    t.r_w.push_back(r_w[i]);
-                    t.t_ptrs.push_back(s.t_ptrs[i]);
-                    auto score = m_ranker.calculate_docscore(
-                                 t.t_ptrs.back()->f_qt,
-                                 size(t.r_w.back())+1,
-                                 t.t_ptrs.back()->f_Dt,
-                                 t.t_ptrs.back()->F_Dt(),
-                                 min_doc_len,
-                                 is_leaf
-                               );
-                    t.score += score;
-                } else if ( ranked_and ) {
-                    return;
+            term_range_info info;
+            uint64_t c;
+            range_type w_range;
+            if ( m_tstats.lookup(m_csa, qry[i].token_ids, info, c) ) {
+                if ( !info.empty() ) {
+                    w_range = m_tstats.w_range(c);
                 }
-            }
-            if (eval){ 
-//                std::cout << t << std::endl;
-                if (profile) res.wt_search_space++;
-                pq.emplace(t);       
-            }
-        };
-
-        constexpr double max_score = std::numeric_limits<double>::max();
-        
-        pq_type pq;
-        size_type search_space=0;
-        pq.emplace(max_score, m_wtd.root(), term_ptrs, v_ranges, m_wtr.root(), w_ranges);
-//        std::cout << "\n" << pq.top() << std::endl;
-        if(profile) res.wt_search_space++;
-
-        while ( !pq.empty() and res.list.size() < k ) {
-            state_type s = pq.top();
-            pq.pop();
-            if ( m_wtd.is_leaf(s.v) ){
-                res.list.emplace_back(m_docperm.len2id[m_wtd.sym(s.v)], s.score);
             } else {
-                auto exp_v = m_wtd.expand(s.v);
-                auto exp_r_v = m_wtd.expand(s.v, s.r_v);
-                auto exp_w = m_wtr.expand(s.w);
-                auto exp_r_w = m_wtr.expand(s.w, s.r_w);
-
-                if ( !m_wtd.empty(std::get<0>(exp_v)) ) {
-                    push_node(pq, s, std::get<0>(exp_v), std::get<0>(exp_r_v), 
-                                     std::get<0>(exp_w), std::get<0>(exp_r_w));
-                }
-                if ( !m_wtd.empty(std::get<1>(exp_v)) ) {
-                    push_node(pq, s, std::get<1>(exp_v), std::get<1>(exp_r_v),
-                                     std::get<1>(exp_w), std::get<1>(exp_r_w));
+                info = m_term_cache.lookup(m_csa, m_df, qry[i].token_ids);
+                if ( !info.empty() ) {
+                    w_range = range_type(m_rrank(info.dup_sp),
+                                         m_rrank(info.dup_ep+1)-1);
                 }
             }
+            if ( !info.empty() ) {
+                terms.emplace_back(qry[i].token_ids, qry[i].f_qt, info.sp, info.ep, info.f_Dt);
+                v_ranges.emplace_back(info.sp, info.ep);
+                w_ranges.push_back(w_range);
+                occ += info.ep - info.sp + 1;
+            }
+        }
+        auto tf = [](size_t, const node_type&, const wt_term_ranges& r){
+            return size(r.w)+1;
+        };
+        auto topk_qry = topk_terms(terms);
+        result res;
+        if ( terms.size() == 1 and m_topk.answer(m_ranker, topk_qry[0], k, profile, res) ){
+            return res;
+        }
+        auto search = make_wt_search(m_wtd, m_wtr, m_docperm, m_ranker, terms, tf);
+        search.set_term_dropping(true);
+        if ( m_cost.direct(occ, k) ){
+            res = search.direct(v_ranges, k, ranked_and, profile);
+        } else {
+            double threshold = m_topk.threshold(m_ranker, topk_qry, k, ranked_and);
+            res = search(v_ranges, w_ranges, k, ranked_and, profile, threshold);
         }
         return res;
     }
 
+    /*! Stores the cost model of the direct evaluation, so that later
+     *  loads use it instead of calibrating it again (see load_direct_cost).
+     */
+    void store_direct_cost(sdsl::cache_config& cc)const{
+        store_to_cache(m_cost, direct_cost_key<t_wtd>(), cc);
+    }
+
     void load(sdsl::cache_config& cc){
         load_from_cache(m_csa, surf::KEY_CSA, cc, true);
         load_from_cache(m_df, surf::KEY_SADADF, cc, true);
@@ -210,12 +132,17 @@ public:
         load_from_cache(m_wtd, surf::KEY_WTD, cc, true);
         std::cerr<<"m_wtd.size()="<<m_wtd.size()<<std::endl;
         std::cerr<<"m_wtd.sigma()="<<m_wtd.sigma<<std::endl;
+        load_direct_cost(m_cost, m_wtd, cc);
         load_from_cache(m_rbv, surf::KEY_DUPMARK, cc, true);
         std::cerr<<"m_rbv.size()="<<m_rbv.size()<<std::endl;
         load_from_cache(m_rrank, surf::KEY_DUPRANK, cc, true);
         m_rrank.set_vector(&m_rbv);
         std::cerr<<"m_rrank(m_rbv.size())="<<m_rrank(m_rbv.size())<<std::endl;
         load_from_cache(m_docperm, surf::KEY_DOCPERM, cc); 
+        load_from_cache(m_tstats, surf::KEY_TERMSTATS_DR, cc);
+        if ( topk_type::enabled ){
+            load_from_cache(m_topk, topk_lists_key<ranker_type>(), cc);
+        }
         m_ranker = ranker_type(cc);
     }
 
@@ -229,6 +156,8 @@ public:
         written_bytes += m_rbv.serialize(out, child, "R_BV");
         written_bytes += m_rrank.serialize(out, child, "R_RANK");
         written_bytes += m_docperm.serialize(out, child, "DOCPERM");
+        written_bytes += m_tstats.serialize(out, child, "TERMSTATS");
+        written_bytes += m_topk.serialize(out, child, "TOPKLISTS");
         structure_tree::add_size(child, written_bytes);
         return written_bytes;
     }
@@ -241,7 +170,12 @@ public:
                    + sdsl::size_in_bytes(m_rbv) 
                    + sdsl::size_in_bytes(m_rrank) 
                   << ";"; // WTR^\ell
-        std::cout << sdsl::size_in_bytes(m_docperm) << std::endl;  // DOCPERM
+        std::cout << sdsl::size_in_bytes(m_docperm) << ";";  // DOCPERM
+        std::cout << sdsl::size_in_bytes(m_tstats) << ";";  // TERMSTATS
+        std::cout << 0 << ";";  // TFBOUNDS
+        std::cout << sdsl::size_in_bytes(m_topk) << ";";  // TOPKLISTS
+        std::cout << 0 << ";";  // RANGETABLE
+        std::cout << sdsl::size_in_bytes(*this) << std::endl;  // total
     }
 
 };
@@ -252,8 +186,9 @@ template<typename t_csa,
          typename t_wtr,
          typename t_ranker,
          typename t_rbv,
-         typename t_rrank>
-void construct(idx_dr<t_csa,t_df,t_wtd,t_wtr, t_ranker, t_rbv, t_rrank>& idx,
+         typename t_rrank,
+         typename t_topk>
+void construct(idx_dr<t_csa,t_df,t_wtd,t_wtr, t_ranker, t_rbv, t_rrank, t_topk>& idx,
                const std::string&,
                sdsl::cache_config& cc, uint8_t num_bytes)
 {    
@@ -304,6 +239,29 @@ void construct(idx_dr<t_csa,t_df,t_wtd,t_wtr, t_ranker, t_rbv, t_rrank>& idx,
         t_rrank rrank(&rbv);
         store_to_cache(rrank, surf::KEY_DUPRANK, cc, true);
     }
+    cout<<"...TERMSTATS"<<endl;
+    if (!cache_file_exists(surf::KEY_TERMSTATS_DR, cc))
+    {
+        t_csa csa;
+        t_df df;
+        t_rbv rbv;
+        t_rrank rrank;
+        load_from_cache(csa, surf::KEY_CSA, cc, true);
+        load_from_cache(df, surf::KEY_SADADF, cc, true);
+        load_from_cache(rbv, surf::KEY_DUPMARK, cc, true);
+        load_from_cache(rrank, surf::KEY_DUPRANK, cc, true);
+        rrank.set_vector(&rbv);
+        auto no_map = [](uint64_t sp, uint64_t ep){ return std::make_pair(sp, ep); };
+        auto r_map = [&rrank](uint64_t sp, uint64_t ep){
+            return std::make_pair(rrank(sp), rrank(ep+1)-1);
+        };
+        term_stats tstats(csa, df, true, r_map, false, no_map);
+        store_to_cache(tstats, surf::KEY_TERMSTATS_DR, cc);
+    }
+    if ( t_topk::enabled ){
+        cout<<"...TOPKLISTS"<<endl;
+        construct_topk_lists<t_csa, t_df, t_ranker>(cc);
+    }
 }
 
 } // end namespace surf
@@ -12,23 +12,43 @@
 #include "surf/block_postings_list.hpp"
 #include "surf/util.hpp"
 #include "surf/rank_functions.hpp"
+#include "surf/topk_lists.hpp"
 
 using namespace sdsl;
 
 namespace surf {
 
 
+//! Inverted index over the postings lists of the single terms
+/*!
+ * \tparam t_pl         Postings list type.
+ * \tparam t_rank       Ranking function.
+ * \tparam t_exhaustive Score every document of the lists instead of using WAND.
+ * \tparam t_block_max  Use the block maxima of the lists to skip blocks
+ *                     which can not hold a top-k document (Block-Max WAND [1]).
+ * \tparam t_topk       Top-K lists of the heavy terms (topk_lists), or
+ *                     no_topk_lists.
+ *
+ * \par Reference
+ *  [1] Shuai Ding, Torsten Suel: ,,Faster top-k document retrieval using
+ *      block-max indexes'', SIGIR 2011.
+ */
 template<class t_pl = block_postings_list<128>,
          class t_rank = rank_bm25<120,75>,
-         bool t_exhaustive = false>
+         bool t_exhaustive = false,
+         bool t_block_max = false,
+         class t_topk = no_topk_lists>
 class idx_invfile {
 public:
     using size_type = sdsl::int_vector<>::size_type;
     using plist_type = t_pl;
     using ranker_type = t_rank;
+    using topk_type = t_topk;
 private:
     // determine lists
     struct plist_wrapper {
+        const plist_type* list = nullptr;
+        size_t block = 0; // block of the last block max check
         typename plist_type::const_iterator cur;
         typename plist_type::const_iterator end;
         double f_qt;
@@ -37,7 +57,8 @@ private:
         double list_max_score;
         double max_doc_weight;
         plist_wrapper() = default;
-        plist_wrapper(plist_type& pl,double _F_t,double _f_qt) {
+        plist_wrapper(const plist_type& pl,double _F_t,double _f_qt) {
+            list = &pl;
             cur = pl.begin();
             end = pl.end();
             list_max_score = pl.list_max_score();
@@ -51,6 +72,7 @@ private:
     std::vector<plist_type> m_postings_lists;
     sdsl::int_vector<> m_F_t;
     sdsl::int_vector<> m_id_mapping;
+    topk_type m_topk;
     ranker_type ranker;
 public:
 	idx_invfile() = default;
@@ -90,6 +112,45 @@ public:
                 sdsl::serialize(pl,ofs);
             }
     	}
+        if( topk_type::enabled && !cache_file_exists(topk_lists_key<ranker_type>(KEY_TOPKLISTS_INVFILE),config) ) {
+            construct_topk_lists(config);
+        }
+    }
+
+    //! Index over postings lists which are already built, e.g. in tests.
+    /*!
+     * \param lists      Postings list of each term id.
+     * \param F_t        Collection frequency of each term id.
+     * \param id_mapping Document id of each id in the lists.
+     * \param r          Ranking function.
+     */
+    idx_invfile(const std::vector<plist_type>& lists, const sdsl::int_vector<>& F_t,
+                const sdsl::int_vector<>& id_mapping, const ranker_type& r)
+        : m_postings_lists(lists), m_F_t(F_t), m_id_mapping(id_mapping), ranker(r)
+    {
+    }
+
+    //! Builds the top-K lists of the heavy terms from the postings lists.
+    //! Their postings are passed in list order, the tie order of WAND.
+    void construct_topk_lists(cache_config& config) const {
+        ranker_type r(config);
+        uint64_t num_docs = m_id_mapping.size();
+        std::vector<uint64_t> ids;
+        std::vector<std::vector<topk_lists::posting_type>> lists;
+        for(size_t i=0;i<m_postings_lists.size();i++) {
+            const auto& pl = m_postings_lists[i];
+            if( pl.size() * topk_lists::default_df_ratio < num_docs ) {
+                continue;
+            }
+            std::vector<topk_lists::posting_type> postings;
+            for(auto itr = pl.begin(); itr != pl.end(); ++itr) {
+                postings.emplace_back(m_id_mapping[itr.docid()],itr.freq());
+            }
+            ids.push_back(i);
+            lists.push_back(topk_lists::select(r,postings,pl.size(),m_F_t[i],topk_lists::default_K));
+        }
+        topk_lists topk(topk_lists::default_K,ids,lists);
+        store_to_cache(topk,topk_lists_key<ranker_type>(KEY_TOPKLISTS_INVFILE),config);
     }
     auto serialize(std::ostream& out, sdsl::structure_tree_node* v=NULL, std::string name="") const -> size_type {
     	structure_tree_node* child = structure_tree::add_child(v, name, util::class_name(*this));
@@ -101,18 +162,22 @@ public:
         for(const auto& pl : m_postings_lists) {
         	written_bytes += sdsl::serialize(pl,out,child,"postings list");
         }
+        written_bytes += m_topk.serialize(out,child,"topk lists");
         structure_tree::add_size(child, written_bytes);
         return written_bytes;
     }
 
     void load(sdsl::cache_config& cc){
         ranker = t_rank(cc);
+        if( topk_type::enabled ) {
+            load_from_cache(m_topk,topk_lists_key<ranker_type>(KEY_TOPKLISTS_INVFILE),cc);
+        }
     }
 
     typename std::vector<plist_wrapper*>::iterator
     find_shortest_list(std::vector<plist_wrapper*>& postings_lists,
                        const typename std::vector<plist_wrapper*>::iterator& end,
-                       uint64_t id) 
+                       uint64_t id) const
     {
         auto itr = postings_lists.begin();
         if (itr != end) {
@@ -130,7 +195,7 @@ public:
         return end;
     }
 
-    void sort_list_by_id(std::vector<plist_wrapper*>& plists) {
+    void sort_list_by_id(std::vector<plist_wrapper*>& plists) const {
         // delete if necessary
         auto del_itr = plists.begin();
         while(del_itr != plists.end()) {
@@ -149,7 +214,7 @@ public:
 
     void forward_lists(std::vector<plist_wrapper*>& postings_lists,
                        const typename std::vector<plist_wrapper*>::iterator& pivot_list,
-                       uint64_t id)
+                       uint64_t id) const
     {
         auto smallest_itr = find_shortest_list(postings_lists,pivot_list+1,id);
 
@@ -173,7 +238,7 @@ public:
     }
 
     std::pair<typename std::vector<plist_wrapper*>::iterator,double>
-    determine_candidate(std::vector<plist_wrapper*>& postings_lists,double threshold,size_t initial_lists,bool ranked_and) {
+    determine_candidate(std::vector<plist_wrapper*>& postings_lists,double threshold,size_t initial_lists,bool ranked_and) const {
 
         if(ranked_and) {
             auto itr = postings_lists.begin();
@@ -214,18 +279,49 @@ public:
         return {end,score};
     }
 
+    //! Upper bound of the score of document id from the blocks of the lists up to the pivot
+    /*! The block pointer of each list is moved to the block which may
+     *  contain id, without decoding it. next is set to the smallest id
+     *  which is not covered by these blocks or is in a list after the pivot,
+     *  i.e. the next document for which the bound can change.
+     */
+    double block_max_score(std::vector<plist_wrapper*>& postings_lists,
+                           const typename std::vector<plist_wrapper*>::iterator& pivot_list,
+                           uint64_t id,
+                           size_t initial_lists,
+                           uint64_t& next) const
+    {
+        double score = 0.0;
+        double max_doc_weight = std::numeric_limits<double>::lowest();
+        next = std::numeric_limits<uint64_t>::max();
+        for(auto itr = postings_lists.begin(); itr != pivot_list+1; itr++) {
+            auto pl = *itr;
+            pl->block = pl->list->find_block_with_id(id,std::max(pl->block,pl->cur.block_id()));
+            if(pl->block < pl->list->num_blocks()) {
+                score += pl->list->block_max_score(pl->block);
+                max_doc_weight = std::max(max_doc_weight,pl->list->block_max_doc_weight(pl->block));
+                next = std::min(next,(uint64_t)pl->list->block_rep(pl->block)+1);
+            }
+        }
+        if(pivot_list+1 != postings_lists.end()) {
+            next = std::min(next,(uint64_t)(*(pivot_list+1))->cur.docid());
+        }
+        return score + (max_doc_weight*initial_lists);
+    }
+
     double evaluate_pivot(std::vector<plist_wrapper*>& postings_lists,
                         std::priority_queue<doc_score,std::vector<doc_score>,std::greater<doc_score>>& heap,
                         double potential_score,
                         double threshold,
                         size_t initial_lists,
-                        size_t k)
+                        size_t k) const
     {
         auto doc_id = postings_lists[0]->cur.docid();
         double W_d = ranker.doc_length(m_id_mapping[doc_id]);
         double doc_score = initial_lists * ranker.calc_doc_weight(W_d);
         potential_score -= doc_score;
 
+        bool pruned = false;
         auto itr = postings_lists.begin();
         auto end = postings_lists.end();
         while(itr != end) {
@@ -241,6 +337,7 @@ public:
                 potential_score -= (*itr)->list_max_score;
                 ++((*itr)->cur); // move to next larger doc_id
                 if(potential_score < threshold) {
+                    pruned = true;
                     /* move the other equal ones ahead still! */
                     itr++;
                     while( itr != end && (*itr)->cur != (*itr)->end && (*itr)->cur.docid() == doc_id ) {
@@ -255,27 +352,31 @@ public:
             itr++;
         }
 
-        // add if it is in the top-k
-        if(heap.size() < k) {
-            heap.push({doc_id,doc_score});
-        } else {
-            if( heap.top().score < doc_score ) {
-                heap.pop();
+        // add if it is in the top-k; a pruned document can not be, but its
+        // score is incomplete, so it must not take a free slot in the heap
+        if(!pruned) {
+            if(heap.size() < k) {
                 heap.push({doc_id,doc_score});
+            } else {
+                if( heap.top().score < doc_score ) {
+                    heap.pop();
+                    heap.push({doc_id,doc_score});
+                }
             }
         }
 
         // resort
         sort_list_by_id(postings_lists);
 
-        if(heap.size()) {
+        // the k-th score is only a threshold once k documents are known
+        if(heap.size() == k) {
             return heap.top().score;
         }
         return 0.0f;
     }
 
     void
-    print_lists(std::vector<plist_wrapper*>& postings_lists,double thres) {
+    print_lists(std::vector<plist_wrapper*>& postings_lists,double thres) const {
         double lm_sum = 0.0;
         std::cout << thres << " ==================================================================\n";
         for(size_t i=0;i<postings_lists.size();i++) {
@@ -292,7 +393,8 @@ public:
         }
     }
 
-    result process_wand(std::vector<plist_wrapper*>& postings_lists,size_t k,bool ranked_and,bool profile) {
+    result process_wand(std::vector<plist_wrapper*>& postings_lists,size_t k,bool ranked_and,bool profile,
+                        double min_threshold = 0.0) const {
         result res;
         // heap containing the top-k docs
         std::priority_queue<doc_score,std::vector<doc_score>,std::greater<doc_score>> score_heap;
@@ -304,7 +406,7 @@ public:
         }
 
         // init list processing 
-        auto threshold = 0.0f;
+        double threshold = std::max(0.0, min_threshold);
         size_t initial_lists = postings_lists.size();
         sort_list_by_id(postings_lists);
         auto pivot_and_score = determine_candidate(postings_lists,threshold,initial_lists,ranked_and);
@@ -312,9 +414,15 @@ public:
         auto potential_score = std::get<1>(pivot_and_score);
 
         while(pivot_list != postings_lists.end()) {
-            if (postings_lists[0]->cur.docid() == (*pivot_list)->cur.docid()) {
+            uint64_t next_id;
+            if (t_block_max && block_max_score(postings_lists,pivot_list,(*pivot_list)->cur.docid(),
+                                               initial_lists,next_id) <= threshold) {
+                // no document before next_id can enter the top-k
+                forward_lists(postings_lists,pivot_list,next_id);
+            } else if (postings_lists[0]->cur.docid() == (*pivot_list)->cur.docid()) {
                 if(profile) res.postings_evaluated++;
-                threshold = evaluate_pivot(postings_lists,score_heap,potential_score,threshold,initial_lists,k);
+                threshold = std::max(min_threshold,
+                                     evaluate_pivot(postings_lists,score_heap,potential_score,threshold,initial_lists,k));
             } else {
                 forward_lists(postings_lists,pivot_list-1,(*pivot_list)->cur.docid());
             }
@@ -342,7 +450,7 @@ public:
     result process_exhaustive(std::vector<plist_wrapper*>& postings_lists,
                               size_t k,
                               bool ranked_and,
-                              bool profile) {
+                              bool profile) const {
         result res;
         // heap containing the top-k docs
         std::priority_queue<doc_score,std::vector<doc_score>,std::greater<doc_score>> score_heap;
@@ -393,22 +501,30 @@ public:
         return res;
     }
 
-    result search(const std::vector<query_token>& qry,size_t k,bool ranked_and = false,bool profile = false) {
+    result search(const std::vector<query_token>& qry,size_t k,bool ranked_and = false,bool profile = false) const {
+        if ( k == 0 ){
+            return result();
+        }
         std::vector<plist_wrapper> pl_data(qry.size());
         std::vector<plist_wrapper*> postings_lists;
+        std::vector<topk_term> topk_qry;
         size_t j=0;
         for(const auto& qry_token : qry) {
-            pl_data[j++] = plist_wrapper(m_postings_lists[qry_token.token_ids[0]],
-                    (double)m_F_t[qry_token.token_ids[0]],(double)qry_token.f_qt);
+            auto id = qry_token.token_ids[0];
+            pl_data[j++] = plist_wrapper(m_postings_lists[id],(double)m_F_t[id],(double)qry_token.f_qt);
             if(pl_data[j-1].list_max_score > 0) {
                 postings_lists.emplace_back(&(pl_data[j-1]));
+                topk_qry.push_back({id,qry_token.f_qt,m_postings_lists[id].size(),m_F_t[id]});
             }
         }
         if(t_exhaustive) {
             return process_exhaustive(postings_lists,k,ranked_and,profile);
-        } else {
-            return process_wand(postings_lists,k,ranked_and,profile);
         }
+        result res;
+        if(topk_qry.size() == 1 && m_topk.answer(ranker,topk_qry[0],k,profile,res)) {
+            return res;
+        }
+        return process_wand(postings_lists,k,ranked_and,profile,m_topk.threshold(ranker,topk_qry,k,ranked_and));
     }
 
     std::pair<double,double> phrase_prob(const std::vector<uint64_t>& ids) const {
@@ -420,13 +536,18 @@ public:
         std::cout << 0 << ";"; // WTD^\ell 
         std::cout << 0 << ";";  // DF
         std::cout << 0 << ";"; // WTR^\ell
-        std::cout << 0 << std::endl;  // DOCPERM
+        std::cout << 0 << ";";  // DOCPERM
+        std::cout << 0 << ";";  // TERMSTATS
+        std::cout << 0 << ";";  // TFBOUNDS
+        std::cout << sdsl::size_in_bytes(m_topk) << ";";  // TOPKLISTS
+        std::cout << 0 << ";";  // RANGETABLE
+        std::cout << sdsl::size_in_bytes(*this) << std::endl;  // total
     }
 
 };
 
-template<class t_pl,class t_rank,bool t_exh>
-void construct(idx_invfile<t_pl,t_rank,t_exh> &idx, const std::string& file,
+template<class t_pl,class t_rank,bool t_exh,bool t_bm,class t_topk>
+void construct(idx_invfile<t_pl,t_rank,t_exh,t_bm,t_topk> &idx, const std::string& file,
                sdsl::cache_config& cconfig, uint8_t num_bytes)
 {
     using namespace sdsl;
@@ -435,7 +556,7 @@ void construct(idx_invfile<t_pl,t_rank,t_exh> &idx, const std::string& file,
 
     surf::construct_col_len<sdsl::int_alphabet_tag::WIDTH>(cconfig);
 
-    idx = idx_invfile<t_pl,t_rank,t_exh>(cconfig);
+    idx = idx_invfile<t_pl,t_rank,t_exh,t_bm,t_topk>(cconfig);
 }
 
 }
@@ -8,4 +8,70 @@
 #include "idx_d1r1.hpp"
 #include "idx_d1r1mtf.hpp"
 
+namespace surf{
+
+//! Sets the number of threads used within a query, if the index supports it.
+template<class t_idx>
+auto set_search_threads(t_idx& idx, size_t threads, int)
+    -> decltype(idx.set_search_threads(threads), bool())
+{
+    idx.set_search_threads(threads);
+    return true;
+}
+
+template<class t_idx>
+bool set_search_threads(t_idx&, size_t, long)
+{
+    return false;
+}
+
+template<class t_idx>
+bool set_search_threads(t_idx& idx, size_t threads)
+{
+    return set_search_threads(idx, threads, 0);
+}
+
+//! Stores the cost model of the direct evaluation, if the index has one.
+template<class t_idx>
+auto store_direct_cost(const t_idx& idx, sdsl::cache_config& cc, int)
+    -> decltype(idx.store_direct_cost(cc), bool())
+{
+    idx.store_direct_cost(cc);
+    return true;
+}
+
+template<class t_idx>
+bool store_direct_cost(const t_idx&, sdsl::cache_config&, long)
+{
+    return false;
+}
+
+template<class t_idx>
+bool store_direct_cost(const t_idx& idx, sdsl::cache_config& cc)
+{
+    return store_direct_cost(idx, cc, 0);
+}
+
+//! Returns the term cache of the index, or nullptr if it has none.
+template<class t_idx>
+auto get_term_cache(const t_idx& idx, int)
+    -> decltype(&idx.term_cache())
+{
+    return &idx.term_cache();
+}
+
+template<class t_idx>
+const term_cache* get_term_cache(const t_idx&, long)
+{
+    return nullptr;
+}
+
+template<class t_idx>
+const term_cache* get_term_cache(const t_idx& idx)
+{
+    return get_term_cache(idx, 0);
+}
+
+} // end namespace surf
+
 #endif
@@ -0,0 +1,143 @@
+#ifndef SURF_LCP_INTERVALS_HPP
+#define SURF_LCP_INTERVALS_HPP
+
+#include <sdsl/int_vector.hpp>
+#include <algorithm>
+#include <functional>
+#include <vector>
+
+namespace surf{
+
+//! An inner node of the suffix tree as reported by lcp_intervals.
+struct lcp_interval{
+    uint64_t        lb;         // left bound of the SA interval
+    uint64_t        rb;         // right bound of the SA interval
+    uint64_t        lcp;        // string depth of the node; 0 for the root
+    uint64_t        parent_lcp; // string depth of the parent; 0 for the children of the root
+    const uint64_t* bounds;     // positions i in (lb,rb] with LCP[i] = lcp in increasing
+    const uint64_t* bounds_end; // order, i.e. the left bounds of the children but the first
+
+    //! Number of children of the node.
+    size_t degree()const{
+        return (bounds_end - bounds) + 1;
+    }
+};
+
+/*! Streaming enumeration of the inner nodes of the suffix tree, i.e. of
+ *  the LCP intervals, in one left-to-right pass over the LCP array
+ *  (bottom-up traversal of [1]). f(v) is called for each interval v
+ *  after the calls for all nested intervals, so the root comes last.
+ *  Leaves are not reported and only the open intervals are kept in
+ *  memory. The parent of an interval is known when it is reported, but
+ *  not its depth in the tree, as the enclosing intervals may still get
+ *  new ancestors. The text is expected to end with a unique sentinel,
+ *  so the root is the only interval with LCP value 0.
+ *
+ * \par Reference
+ *  [1] M.I. Abouelhoda, S. Kurtz, E. Ohlebusch: ,,Replacing suffix trees
+ *      with enhanced suffix arrays'', JDA 2004.
+ */
+template<class t_lcp, class t_func>
+void lcp_intervals(t_lcp& lcp, t_func f)
+{
+    struct interval{
+        uint64_t lcp;
+        uint64_t lb;
+        size_t   bounds_begin; // offset of its child bounds in `bounds`
+    };
+    const uint64_t n = lcp.size();
+    if ( n == 0 ){
+        return;
+    }
+    // the child bounds of the open intervals; the ones of an interval
+    // follow the ones of the enclosing intervals
+    std::vector<uint64_t> bounds;
+    std::vector<interval> stack;
+    stack.push_back({0, 0, 0});
+    for (uint64_t i = 1; i <= n; ++i){
+        uint64_t l = i < n ? (uint64_t)lcp[i] : 0;
+        uint64_t lb = i-1;
+        while ( l < stack.back().lcp ){
+            interval x = stack.back();
+            stack.pop_back();
+            // the parent is either the next open interval or a new one with LCP value l
+            f(lcp_interval{x.lb, i-1, x.lcp, std::max(stack.back().lcp, l),
+                           bounds.data()+x.bounds_begin, bounds.data()+bounds.size()});
+            bounds.resize(x.bounds_begin);
+            lb = x.lb;
+        }
+        if ( i == n ){
+            break;
+        }
+        if ( l > stack.back().lcp ){
+            stack.push_back({l, lb, bounds.size()});
+        }
+        bounds.push_back(i);
+    }
+    f(lcp_interval{0, n-1, 0, 0, bounds.data(), bounds.data()+bounds.size()});
+}
+
+/*! Calls f(lb, rb) for the children of the root of the suffix tree from
+ *  left to right, leaves included. The children are separated by the
+ *  positions with LCP value 0.
+ */
+template<class t_lcp, class t_func>
+void root_children(t_lcp& lcp, t_func f)
+{
+    const uint64_t n = lcp.size();
+    uint64_t lb = 0;
+    for (uint64_t i = 1; i < n; ++i){
+        if ( lcp[i] == 0 ){
+            f(lb, i-1);
+            lb = i;
+        }
+    }
+    if ( n > 0 ){
+        f(lb, n-1);
+    }
+}
+
+/*! Calls f(lb, rb) from left to right for the blocks of depth `depth`
+ *  of the suffix tree: the nodes at depth `depth` and the leaves at a
+ *  smaller depth. The blocks partition the suffix array and every node
+ *  up to depth `depth` is a union of consecutive blocks. Depth 1 gives
+ *  the children of the root (see root_children); depth 0 is not allowed.
+ */
+template<class t_lcp, class t_func>
+void depth_blocks(t_lcp& lcp, uint64_t depth, t_func f)
+{
+    std::vector<uint64_t> l; // LCP values of the current child of the root
+    uint64_t base = 0;       // its left bound, i.e. l[i-base] = LCP[i]
+    // splits node [lb,rb] of depth d into its children
+    std::function<void(uint64_t,uint64_t,uint64_t)> split = [&](uint64_t lb, uint64_t rb, uint64_t d){
+        if ( lb == rb or d == depth ){
+            f(lb, rb);
+            return;
+        }
+        uint64_t min_lcp = *std::min_element(l.begin()+(lb+1-base), l.begin()+(rb+1-base));
+        uint64_t child_lb = lb;
+        for (uint64_t i = lb+1; i <= rb; ++i){
+            if ( l[i-base] == min_lcp ){
+                split(child_lb, i-1, d+1);
+                child_lb = i;
+            }
+        }
+        split(child_lb, rb, d+1);
+    };
+    root_children(lcp, [&](uint64_t lb, uint64_t rb){
+        if ( depth == 1 or lb == rb ){
+            f(lb, rb);
+            return;
+        }
+        l.clear();
+        base = lb;
+        for (uint64_t i = lb; i <= rb; ++i){
+            l.push_back(lcp[i]);
+        }
+        split(lb, rb, 1);
+    });
+}
+
+} // end namespace surf
+
+#endif
@@ -0,0 +1,26 @@
+#ifndef SURF_RAM_BUDGET_HPP
+#define SURF_RAM_BUDGET_HPP
+
+#include <cstdint>
+
+namespace surf{
+
+/*! RAM budget (in bytes) of the index construction; 0 means no limit.
+ *  Construction steps whose working set exceeds the budget switch to
+ *  variants which stream their input or process it in chunked passes.
+ */
+inline uint64_t& construct_ram_budget()
+{
+    static uint64_t budget = 0;
+    return budget;
+}
+
+//! Returns true if a working set of `bytes` bytes fits into the RAM budget.
+inline bool fits_ram_budget(uint64_t bytes)
+{
+    return construct_ram_budget() == 0 or bytes <= construct_ram_budget();
+}
+
+}// end namespace
+
+#endif
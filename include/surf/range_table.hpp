@@ -0,0 +1,202 @@
+#ifndef SURF_RANGE_TABLE_HPP
+#define SURF_RANGE_TABLE_HPP
+
+#include "sdsl/int_vector.hpp"
+#include "sdsl/wavelet_trees.hpp"
+#include "surf/config.hpp"
+#include <algorithm>
+#include <string>
+#include <vector>
+
+namespace surf{
+
+using range_type = sdsl::range_type;
+
+/*! Returns the nodes of level `level` of wt, indexed by their symbol.
+ *  Nodes which hold no element are included (with size 0).
+ */
+template<class t_wt>
+std::vector<typename t_wt::node_type> wt_level_nodes(const t_wt& wt, uint64_t level)
+{
+    std::vector<typename t_wt::node_type> nodes(1, wt.root());
+    for (uint64_t l = 0; l < level; ++l){
+        std::vector<typename t_wt::node_type> next(2*nodes.size());
+        for (const auto& v : nodes){
+            auto exp_v = wt.expand(v);
+            next[std::get<0>(exp_v).sym] = std::get<0>(exp_v);
+            next[std::get<1>(exp_v).sym] = std::get<1>(exp_v);
+        }
+        nodes.swap(next);
+    }
+    return nodes;
+}
+
+/*! Maps the range r of the root of wt to the nodes of level `level`.
+ *  out[s] is set to the range in the node with symbol s; only nodes
+ *  which the range reaches are visited, the others get an empty range.
+ */
+template<class t_wt>
+void wt_level_ranges(const t_wt& wt, const range_type& r, uint64_t level, range_type* out)
+{
+    std::fill(out, out + (1ULL<<level), range_type(1, 0));
+    std::vector<std::pair<typename t_wt::node_type, range_type>> stack;
+    if ( !sdsl::empty(r) ){
+        stack.emplace_back(wt.root(), r);
+    }
+    while ( !stack.empty() ){
+        auto v = stack.back().first;
+        auto v_r = stack.back().second;
+        stack.pop_back();
+        if ( v.level == level ){
+            out[v.sym] = v_r;
+            continue;
+        }
+        auto exp_v = wt.expand(v);
+        auto exp_r = wt.expand(v, v_r);
+        for (size_t c = 0; c < 2; ++c){
+            if ( !sdsl::empty(exp_r[c]) ){
+                stack.emplace_back(exp_v[c], exp_r[c]);
+            }
+        }
+    }
+}
+
+//! Placeholder for indexes without a range table.
+struct no_range_table{
+    typedef sdsl::int_vector<>::size_type size_type;
+    static const bool enabled = false;
+
+    no_range_table() = default;
+
+    template<class... t_args>
+    no_range_table(t_args&&...) {}
+
+    uint64_t levels()const{
+        return 0;
+    }
+
+    size_type size()const{
+        return 0;
+    }
+
+    uint64_t row(const std::vector<uint64_t>&)const{
+        return 0;
+    }
+
+    void ranges(uint64_t, range_type*)const{}
+
+    size_type serialize(std::ostream&, sdsl::structure_tree_node* v=nullptr, std::string name="")const{
+        sdsl::structure_tree_node* child = sdsl::structure_tree::add_child(v, name, sdsl::util::class_name(*this));
+        sdsl::structure_tree::add_size(child, 0);
+        return 0;
+    }
+
+    void load(std::istream&){}
+};
+
+/*! Ranges of the frequent terms in the nodes of level t_levels of the WT
+ *  over the D array. The first levels of the WT are expanded for every
+ *  query, and for a term this always results in the same ranges. For
+ *  each term which occurs at least t_min_occ times, the (node relative)
+ *  range in each of the 2^t_levels nodes of the level is stored, so that
+ *  a traversal can start on that level instead of at the root.
+ */
+template<uint32_t t_levels=8, uint64_t t_min_occ=65536>
+class range_table{
+public:
+    typedef sdsl::int_vector<>::size_type size_type;
+    static const bool enabled = true;
+private:
+    uint64_t           m_levels = 0;    // level of the stored ranges
+    sdsl::int_vector<> m_ids;           // sorted ids of the stored terms
+    sdsl::int_vector<> m_sp;            // 2^m_levels range starts per term
+    sdsl::int_vector<> m_size;          // 2^m_levels range sizes per term
+public:
+    range_table() = default;
+
+    //! Builds the table from the CSA and the WT over the D array.
+    template<class t_csa, class t_wt>
+    range_table(const t_csa& csa, const t_wt& wt){
+        m_levels = std::min((uint64_t)t_levels, (uint64_t)wt.max_level);
+        const uint64_t buckets = 1ULL<<m_levels;
+        std::vector<uint64_t> ids;
+        std::vector<uint64_t> sp;
+        std::vector<uint64_t> size;
+        std::vector<range_type> r(buckets);
+        for (size_type c=1; c<csa.sigma; ++c){
+            uint64_t c_sp = csa.C[c], c_ep = csa.C[c+1]-1;
+            if ( c_ep-c_sp+1 < t_min_occ ){
+                continue;
+            }
+            ids.push_back(csa.comp2char[c]);
+            wt_level_ranges(wt, range_type(c_sp, c_ep), m_levels, r.data());
+            for (const auto& x : r){
+                sp.push_back(sdsl::empty(x) ? 0 : x.first);
+                size.push_back(sdsl::size(x));
+            }
+        }
+        m_ids = sdsl::int_vector<>(ids.size());
+        std::copy(ids.begin(), ids.end(), m_ids.begin());
+        sdsl::util::bit_compress(m_ids);
+        m_sp = sdsl::int_vector<>(sp.size());
+        std::copy(sp.begin(), sp.end(), m_sp.begin());
+        sdsl::util::bit_compress(m_sp);
+        m_size = sdsl::int_vector<>(size.size());
+        std::copy(size.begin(), size.end(), m_size.begin());
+        sdsl::util::bit_compress(m_size);
+    }
+
+    //! Level of the WT for which ranges are stored.
+    uint64_t levels()const{
+        return m_levels;
+    }
+
+    //! Number of terms in the table.
+    size_type size()const{
+        return m_ids.size();
+    }
+
+    //! Row of a single-term token in the table (starting at 1), or 0 if it is not stored.
+    uint64_t row(const std::vector<uint64_t>& ids)const{
+        if ( ids.size() != 1 ){
+            return 0;
+        }
+        auto itr = std::lower_bound(m_ids.begin(), m_ids.end(), ids[0]);
+        if ( itr == m_ids.end() or *itr != ids[0] ){
+            return 0;
+        }
+        return (itr - m_ids.begin()) + 1;
+    }
+
+    //! Sets out[s] to the range of the term in row in the node with symbol s.
+    void ranges(uint64_t row, range_type* out)const{
+        const uint64_t buckets = 1ULL<<m_levels;
+        for (uint64_t s = 0, i = (row-1)*buckets; s < buckets; ++s, ++i){
+            uint64_t sp = m_sp[i], size = m_size[i];
+            out[s] = size ? range_type(sp, sp + size - 1) : range_type(1, 0);
+        }
+    }
+
+    size_type serialize(std::ostream& out, sdsl::structure_tree_node* v=nullptr, std::string name="")const{
+        using namespace sdsl;
+        structure_tree_node* child = structure_tree::add_child(v, name, util::class_name(*this));
+        size_type written_bytes = 0;
+        written_bytes += write_member(m_levels, out, child, "levels");
+        written_bytes += m_ids.serialize(out, child, "ids");
+        written_bytes += m_sp.serialize(out, child, "sp");
+        written_bytes += m_size.serialize(out, child, "size");
+        structure_tree::add_size(child, written_bytes);
+        return written_bytes;
+    }
+
+    void load(std::istream& in){
+        sdsl::read_member(m_levels, in);
+        m_ids.load(in);
+        m_sp.load(in);
+        m_size.load(in);
+    }
+};
+
+} // end namespace surf
+
+#endif
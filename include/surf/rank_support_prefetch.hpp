@@ -0,0 +1,120 @@
+#ifndef SURF_RANK_SUPPORT_PREFETCH_HPP
+#define SURF_RANK_SUPPORT_PREFETCH_HPP
+
+#include "sdsl/int_vector.hpp"
+#include "sdsl/rank_support.hpp"
+#include "sdsl/util.hpp"
+#include <string>
+
+namespace surf{
+
+/*! Rank support for the ones of a bit_vector with the layout of
+ *  sdsl::rank_support_v5 (6.25% extra space), which exposes the address
+ *  of the sample a lookup reads, so that it can be prefetched.
+ *  The bits are split into superblocks of 2048 bits. For each superblock
+ *  two words are stored: the number of ones before it, and the number of
+ *  ones before the 2nd, 3rd and 4th 512-bit block inside it (12 bits
+ *  each). A lookup reads these two words and popcounts at most 8 words
+ *  of the block it falls into.
+ */
+class rank_support_prefetch : public sdsl::rank_support{
+public:
+    typedef sdsl::bit_vector bit_vector_type;
+    typedef sdsl::bit_vector::size_type size_type;
+private:
+    sdsl::int_vector<64> m_samples;
+public:
+    explicit rank_support_prefetch(const sdsl::bit_vector* v=nullptr){
+        set_vector(v);
+        if ( v == nullptr ){
+            return;
+        }
+        const size_type n = v->size();
+        const size_type words = (n+63)>>6;
+        const size_type superblocks = (n>>11) + 1;
+        m_samples = sdsl::int_vector<64>(2*superblocks, 0);
+        const uint64_t* data = v->data();
+        uint64_t ones = 0, rel = 0, packed = 0;
+        for (size_type w = 0; w < 32*superblocks; ++w){
+            if ( (w & 31) == 0 ){
+                m_samples[2*(w>>5)] = ones;
+                rel = packed = 0;
+            } else if ( (w & 7) == 0 ){
+                packed |= rel << (12*(((w>>3)&3)-1));
+                m_samples[2*(w>>5)+1] = packed;
+            }
+            uint64_t x = w < words ? data[w] : 0;
+            if ( w+1 == words and (n&63) ){
+                x &= (1ULL << (n&63)) - 1;
+            }
+            uint64_t c = sdsl::bits::cnt(x);
+            ones += c;
+            rel += c;
+        }
+    }
+
+    rank_support_prefetch(const rank_support_prefetch&) = default;
+    rank_support_prefetch(rank_support_prefetch&&) = default;
+    rank_support_prefetch& operator=(const rank_support_prefetch&) = default;
+    rank_support_prefetch& operator=(rank_support_prefetch&&) = default;
+
+    //! Number of ones in [0, i)
+    size_type rank(size_type i)const{
+        const uint64_t* s = m_samples.data() + 2*(i>>11);
+        size_type res = s[0];
+        uint64_t block = (i>>9) & 3;
+        if ( block ){
+            res += (s[1] >> (12*(block-1))) & 0xFFF;
+        }
+        const uint64_t* w = m_v->data() + ((i>>9)<<3);
+        const uint64_t* e = m_v->data() + (i>>6);
+        for (; w < e; ++w){
+            res += sdsl::bits::cnt(*w);
+        }
+        if ( i & 63 ){
+            res += sdsl::bits::cnt(*e & ((1ULL << (i&63)) - 1));
+        }
+        return res;
+    }
+
+    size_type operator()(size_type i)const{
+        return rank(i);
+    }
+
+    //! Prefetches the sample and the first word of the block read by rank(i).
+    void prefetch(size_type i)const{
+        __builtin_prefetch(m_samples.data() + 2*(i>>11));
+        __builtin_prefetch(m_v->data() + ((i>>9)<<3));
+    }
+
+    size_type size()const{
+        return m_v->size();
+    }
+
+    void set_vector(const sdsl::bit_vector* v=nullptr){
+        m_v = v;
+    }
+
+    void swap(rank_support_prefetch& rs){
+        if ( this != &rs ){
+            m_samples.swap(rs.m_samples);
+        }
+    }
+
+    size_type serialize(std::ostream& out, sdsl::structure_tree_node* v=nullptr, std::string name="")const{
+        using namespace sdsl;
+        structure_tree_node* child = structure_tree::add_child(v, name, util::class_name(*this));
+        size_type written_bytes = m_samples.serialize(out, child, "samples");
+        structure_tree::add_size(child, written_bytes);
+        return written_bytes;
+    }
+
+    void load(std::istream& in, const sdsl::bit_vector* v=nullptr){
+        set_vector(v);
+        m_samples.load(in);
+    }
+};
+
+} // end namespace surf
+
+#endif
@@ -0,0 +1,74 @@
+#ifndef SURF_SEARCH_ARENA_HPP
+#define SURF_SEARCH_ARENA_HPP
+
+#include <cstdint>
+#include <vector>
+#include <algorithm>
+
+namespace surf{
+
+/*! A per-query arena for the payload (term pointers and SA ranges) of the
+ *  states of the best-first wavelet tree traversals.
+ *  Blocks are addressed by offset, so growing the buffer does not
+ *  invalidate the states which are still stored in the priority queue.
+ *  Released blocks are kept in one free list per block size (a block
+ *  never holds more elements than there are query terms) and are handed
+ *  out again before the buffer grows. The arena is only reset between
+ *  queries and keeps its capacity, so after warm-up expanding a node
+ *  does not touch the heap.
+ */
+template<typename t_elem>
+class search_arena{
+public:
+    typedef uint64_t size_type;
+private:
+    std::vector<t_elem>                 m_buf;
+    size_type                           m_top = 0;
+    std::vector<std::vector<size_type>> m_free; // free blocks by size
+public:
+    void clear(){
+        m_top = 0;
+        for (auto& f : m_free){
+            f.clear();
+        }
+    }
+
+    //! Get a block of n consecutive elements and return its offset.
+    size_type alloc(size_type n){
+        if ( n < m_free.size() and !m_free[n].empty() ){
+            size_type offset = m_free[n].back();
+            m_free[n].pop_back();
+            return offset;
+        }
+        if ( m_top + n > m_buf.size() ){
+            m_buf.resize(std::max(2*m_buf.size(), m_top + n));
+        }
+        size_type offset = m_top;
+        m_top += n;
+        return offset;
+    }
+
+    //! Return a block of n elements which was obtained by alloc(n).
+    void release(size_type offset, size_type n){
+        if ( offset + n == m_top ){
+            m_top = offset;
+            return;
+        }
+        if ( n >= m_free.size() ){
+            m_free.resize(n+1);
+        }
+        m_free[n].push_back(offset);
+    }
+
+    t_elem* at(size_type offset){
+        return m_buf.data() + offset;
+    }
+
+    const t_elem* at(size_type offset)const{
+        return m_buf.data() + offset;
+    }
+};
+
+} // end namespace surf
+
+#endif
@@ -0,0 +1,89 @@
+#ifndef SURF_SHARED_TOPK_HPP
+#define SURF_SHARED_TOPK_HPP
+
+#include "surf/wt_batch.hpp"
+#include <cstdint>
+#include <vector>
+#include <mutex>
+#include <atomic>
+#include <limits>
+#include <algorithm>
+#include <functional>
+
+namespace surf{
+
+/*! The k best leaves found by the threads of a parallel WT traversal.
+ *  Insertions are serialized by a mutex. The score of the k-th best leaf
+ *  is published in an atomic, so the threads can prune against it
+ *  without taking the lock. As long as fewer than k leaves were found
+ *  the threshold is the lowest double, or an initial threshold which is
+ *  known to be exceeded by the k-th best leaf. Leaves with equal score are
+ *  ordered by their WT node, as in the best-first traversal.
+ */
+template<typename t_node>
+class shared_topk{
+public:
+    struct entry{
+        double   score;
+        t_node   v;
+        uint64_t doc_id;
+
+        bool operator<(const entry& e)const{
+            if ( score != e.score ){
+                return score < e.score;
+            }
+            return node_less(v, e.v);
+        }
+        bool operator>(const entry& e)const{
+            return e < *this;
+        }
+    };
+private:
+    size_t              m_k;
+    std::vector<entry>  m_heap; // min-heap
+    std::mutex          m_mtx;
+    std::atomic<double> m_threshold;
+    double              m_min_threshold;
+public:
+    shared_topk(size_t k, double threshold=std::numeric_limits<double>::lowest()) :
+        m_k(k), m_threshold(threshold), m_min_threshold(threshold) {
+        m_heap.reserve(k);
+    }
+
+    //! Score of the k-th best leaf; a candidate below it can not make it into the top-k.
+    double threshold()const{
+        return m_threshold.load(std::memory_order_relaxed);
+    }
+
+    void insert(double score, const t_node& v, uint64_t doc_id){
+        if ( m_k == 0 ){
+            return;
+        }
+        entry e{score, v, doc_id};
+        std::lock_guard<std::mutex> lock(m_mtx);
+        if ( m_heap.size() < m_k ){
+            m_heap.push_back(e);
+            std::push_heap(m_heap.begin(), m_heap.end(), std::greater<entry>());
+        } else if ( m_heap.front() < e ){
+            std::pop_heap(m_heap.begin(), m_heap.end(), std::greater<entry>());
+            m_heap.back() = e;
+            std::push_heap(m_heap.begin(), m_heap.end(), std::greater<entry>());
+        } else {
+            return;
+        }
+        if ( m_heap.size() == m_k ){
+            m_threshold.store(std::max(m_min_threshold, m_heap.front().score), std::memory_order_relaxed);
+        }
+    }
+
+    //! The entries in decreasing order. Call after all threads finished.
+    std::vector<entry> sorted()const{
+        std::vector<entry> res(m_heap);
+        std::sort(res.begin(), res.end(), std::greater<entry>());
+        return res;
+    }
+};
+
+} // end namespace surf
+
+#endif
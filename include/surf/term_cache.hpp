@@ -0,0 +1,156 @@
+#ifndef SURF_TERM_CACHE_HPP
+#define SURF_TERM_CACHE_HPP
+
+#include <cstdint>
+#include <vector>
+#include <list>
+#include <tuple>
+#include <unordered_map>
+#include <mutex>
+#include <atomic>
+#include <ostream>
+
+namespace surf{
+
+//! Result of the backward search and df lookup of a query token.
+struct term_range_info{
+    uint64_t sp = 1;     // start of the SA interval of the token
+    uint64_t ep = 0;     // end of the SA interval of the token
+    uint64_t f_Dt = 0;   // number of distinct documents the token occurs in
+    uint64_t dup_sp = 0; // start of the interval in the duplication array
+    uint64_t dup_ep = 0; // end of the interval in the duplication array
+
+    bool empty() const{
+        return sp > ep;
+    }
+};
+
+/*! A bounded, thread-safe LRU cache which maps the token id sequence of a
+ *  term or phrase to its SA interval and document frequency information.
+ *  Tokens which do not occur in the collection are cached as well.
+ *  Misses are computed outside of the lock, so concurrent queries only
+ *  serialize on the hash map and list updates.
+ */
+class term_cache{
+public:
+    typedef std::vector<uint64_t> key_type;
+    static const size_t default_capacity = 1<<16;
+private:
+    struct key_hash{
+        size_t operator()(const key_type& key) const{
+            uint64_t h = 14695981039346656037ULL;
+            for (auto x : key){
+                h ^= x + 0x9e3779b97f4a7c15ULL + (h << 6) + (h >> 2);
+            }
+            return h;
+        }
+    };
+    typedef std::list<std::pair<key_type, term_range_info>> list_type;
+
+    std::atomic<size_t>   m_capacity; // written under m_mtx, read without it by lookup
+    list_type             m_lru; // most recently used first
+    std::unordered_map<key_type, list_type::iterator, key_hash> m_map;
+    mutable std::mutex    m_mtx;
+    std::atomic<uint64_t> m_hits;
+    std::atomic<uint64_t> m_misses;
+public:
+    term_cache(size_t capacity=default_capacity) : m_capacity(capacity), m_hits(0), m_misses(0) {}
+
+    //! Copies only the capacity, not the content.
+    term_cache(const term_cache& tc) : term_cache(tc.capacity()) {}
+
+    term_cache& operator=(const term_cache& tc){
+        if ( this != &tc ){
+            set_capacity(tc.capacity());
+        }
+        return *this;
+    }
+
+    //! Sets the maximal number of cached tokens; 0 disables the cache.
+    void set_capacity(size_t capacity){
+        std::lock_guard<std::mutex> lock(m_mtx);
+        m_capacity = capacity;
+        while ( m_lru.size() > m_capacity ){
+            m_map.erase(m_lru.back().first);
+            m_lru.pop_back();
+        }
+    }
+
+    size_t capacity() const{
+        return m_capacity.load();
+    }
+
+    uint64_t hits() const{
+        return m_hits.load();
+    }
+
+    uint64_t misses() const{
+        return m_misses.load();
+    }
+
+    double hit_rate() const{
+        uint64_t h = hits(), m = misses();
+        return (h+m) ? (double)h/(h+m) : 0.0;
+    }
+
+    /*! Returns the interval information of the token ids, either from the
+     *  cache or by a backward search in csa and a lookup in df.
+     */
+    template<class t_csa, class t_df>
+    term_range_info lookup(const t_csa& csa, const t_df& df, const key_type& ids){
+        if ( m_capacity > 0 ){
+            std::lock_guard<std::mutex> lock(m_mtx);
+            auto itr = m_map.find(ids);
+            if ( itr != m_map.end() ){
+                m_lru.splice(m_lru.begin(), m_lru, itr->second);
+                ++m_hits;
+                return itr->second->second;
+            }
+        }
+        ++m_misses;
+        term_range_info info;
+        uint64_t sp=1, ep=0;
+        if ( backward_search(csa, 0, csa.size()-1, ids.begin(), ids.end(), sp, ep) > 0 ){
+            auto df_info = df(sp, ep);
+            info.sp = sp;
+            info.ep = ep;
+            info.f_Dt = std::get<0>(df_info);
+            info.dup_sp = std::get<1>(df_info);
+            info.dup_ep = std::get<2>(df_info);
+        }
+        insert(ids, info);
+        return info;
+    }
+
+    void insert(const key_type& ids, const term_range_info& info){
+        std::lock_guard<std::mutex> lock(m_mtx);
+        if ( m_capacity == 0 or m_map.find(ids) != m_map.end() ){
+            return;
+        }
+        m_lru.emplace_front(ids, info);
+        m_map[ids] = m_lru.begin();
+        if ( m_lru.size() > m_capacity ){
+            m_map.erase(m_lru.back().first);
+            m_lru.pop_back();
+        }
+    }
+
+    void clear(){
+        std::lock_guard<std::mutex> lock(m_mtx);
+        m_lru.clear();
+        m_map.clear();
+        m_hits = 0;
+        m_misses = 0;
+    }
+};
+
+inline std::ostream& operator<<(std::ostream& os, const term_cache& tc)
+{
+    os << "term cache: hits=" << tc.hits() << " misses=" << tc.misses()
+       << " hit rate=" << tc.hit_rate();
+    return os;
+}
+
+} // end namespace surf
+
+#endif
@@ -0,0 +1,160 @@
+#ifndef SURF_TERM_STATS_HPP
+#define SURF_TERM_STATS_HPP
+
+#include "sdsl/int_vector.hpp"
+#include "surf/term_cache.hpp"
+#include <string>
+#include <tuple>
+#include <utility>
+#include <vector>
+#include <algorithm>
+#include <stdexcept>
+
+namespace surf{
+
+/*! Precomputed statistics of all single-term tokens of the collection.
+ *  The SA interval of a term is the bucket [C[c], C[c+1]-1] of its
+ *  compact character c in the CSA, so it is not stored. For each c
+ *  the table holds
+ *   - f_Dt, the number of distinct documents containing the term
+ *   - optionally the interval in the WT over the repetition array,
+ *     i.e. the DUP interval mapped through the rank of the R marks
+ *   - optionally the interval in the WT over D1, i.e. the SA interval
+ *     mapped through the rank of the D1 marks
+ */
+class term_stats{
+public:
+    typedef sdsl::int_vector<>::size_type size_type;
+    typedef std::pair<uint64_t, uint64_t> range_type;
+private:
+    uint64_t           m_max_id = 0; // ids >= m_max_id do not occur
+    sdsl::int_vector<> m_f_Dt;
+    sdsl::int_vector<> m_w_sp;
+    sdsl::int_vector<> m_w_size; // ep-sp+1
+    sdsl::int_vector<> m_v_sp;
+    sdsl::int_vector<> m_v_size; // ep-sp+1
+
+    static sdsl::int_vector<> compress(const std::vector<uint64_t>& v){
+        uint64_t max = 0;
+        for (auto x : v){ max = std::max(max, x); }
+        sdsl::int_vector<> iv(v.size(), 0, max ? sdsl::bits::hi(max)+1 : 1);
+        for (size_type i=0; i<v.size(); ++i){ iv[i] = v[i]; }
+        return iv;
+    }
+
+public:
+    term_stats() = default;
+
+    /*! Builds the table. w_map and v_map are called with the interval of
+     *  a term in the DUP array and in SA respectively and return the
+     *  mapped interval. If store_w (store_v) is false the corresponding
+     *  columns are left empty.
+     */
+    template<class t_csa, class t_df, class t_wmap, class t_vmap>
+    term_stats(const t_csa& csa, const t_df& df, bool store_w, t_wmap w_map,
+               bool store_v, t_vmap v_map){
+        size_type sigma = csa.sigma;
+        m_max_id = sigma > 1 ? csa.comp2char[sigma-1]+1 : 0;
+        std::vector<uint64_t> f_Dt(sigma,0), w_sp, w_size, v_sp, v_size;
+        if ( store_w ){ w_sp.resize(sigma,0); w_size.resize(sigma,0); }
+        if ( store_v ){ v_sp.resize(sigma,0); v_size.resize(sigma,0); }
+        for (size_type c=1; c<sigma; ++c){
+            uint64_t sp = csa.C[c], ep = csa.C[c+1]-1;
+            auto df_info = df(sp, ep);
+            f_Dt[c] = std::get<0>(df_info);
+            if ( store_w ){
+                auto r = w_map(std::get<1>(df_info), std::get<2>(df_info));
+                w_sp[c] = r.first;
+                w_size[c] = r.second - r.first + 1;
+            }
+            if ( store_v ){
+                auto r = v_map(sp, ep);
+                v_sp[c] = r.first;
+                v_size[c] = r.second - r.first + 1;
+            }
+        }
+        m_f_Dt = compress(f_Dt);
+        m_w_sp = compress(w_sp);
+        m_w_size = compress(w_size);
+        m_v_sp = compress(v_sp);
+        m_v_size = compress(v_size);
+    }
+
+    //! True if the table was not built or could not be loaded.
+    bool empty()const{
+        return m_f_Dt.size() == 0;
+    }
+
+    bool has_w_ranges()const{
+        return m_w_sp.size() > 0;
+    }
+
+    bool has_v_ranges()const{
+        return m_v_sp.size() > 0;
+    }
+
+    /*! Resolves a token from the table. Returns false, if this is not
+     *  possible, i.e. the token is a phrase or no table is present.
+     *  Otherwise info holds the interval and f_Dt of the term, or is
+     *  empty if the term does not occur, and c is its compact character.
+     */
+    template<class t_csa>
+    bool lookup(const t_csa& csa, const std::vector<uint64_t>& ids,
+                term_range_info& info, uint64_t& c)const{
+        if ( ids.size() != 1 or empty() ){
+            return false;
+        }
+        c = ids[0] < m_max_id ? (uint64_t)csa.char2comp[ids[0]] : 0;
+        if ( c == 0 ){
+            info = term_range_info();
+            return true;
+        }
+        info.sp = csa.C[c];
+        info.ep = csa.C[c+1]-1;
+        info.f_Dt = m_f_Dt[c];
+        return true;
+    }
+
+    //! Range of term c in the second WT; the table has to hold them.
+    range_type w_range(uint64_t c)const{
+        if ( !has_w_ranges() ){
+            throw std::logic_error("term_stats: the table holds no ranges of the second WT.");
+        }
+        return range_type(m_w_sp[c], m_w_sp[c] + m_w_size[c] - 1);
+    }
+
+    //! Range of term c in the first WT; the table has to hold them.
+    range_type v_range(uint64_t c)const{
+        if ( !has_v_ranges() ){
+            throw std::logic_error("term_stats: the table holds no ranges of the first WT.");
+        }
+        return range_type(m_v_sp[c], m_v_sp[c] + m_v_size[c] - 1);
+    }
+
+    size_type serialize(std::ostream& out, sdsl::structure_tree_node* v=nullptr, std::string name="")const{
+        using namespace sdsl;
+        structure_tree_node* child = structure_tree::add_child(v, name, util::class_name(*this));
+        size_type written_bytes = 0;
+        written_bytes += write_member(m_max_id, out, child, "max_id");
+        written_bytes += m_f_Dt.serialize(out, child, "f_Dt");
+        written_bytes += m_w_sp.serialize(out, child, "w_sp");
+        written_bytes += m_w_size.serialize(out, child, "w_size");
+        written_bytes += m_v_sp.serialize(out, child, "v_sp");
+        written_bytes += m_v_size.serialize(out, child, "v_size");
+        structure_tree::add_size(child, written_bytes);
+        return written_bytes;
+    }
+
+    void load(std::istream& in){
+        sdsl::read_member(m_max_id, in);
+        m_f_Dt.load(in);
+        m_w_sp.load(in);
+        m_w_size.load(in);
+        m_v_sp.load(in);
+        m_v_size.load(in);
+    }
+};
+
+} // end namespace surf
+
+#endif
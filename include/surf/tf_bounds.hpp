@@ -0,0 +1,161 @@
+#ifndef SURF_TF_BOUNDS_HPP
+#define SURF_TF_BOUNDS_HPP
+
+#include "sdsl/int_vector.hpp"
+#include "sdsl/int_vector_buffer.hpp"
+#include "surf/config.hpp"
+#include <algorithm>
+#include <string>
+#include <vector>
+
+namespace surf{
+
+//! Placeholder for indexes without term frequency bounds.
+struct no_tf_bounds{
+    typedef sdsl::int_vector<>::size_type size_type;
+    static const bool enabled = false;
+
+    no_tf_bounds() = default;
+
+    template<class... t_args>
+    no_tf_bounds(t_args&&...) {}
+
+    uint64_t levels()const{
+        return 0;
+    }
+
+    uint64_t row(const std::vector<uint64_t>&)const{
+        return 0;
+    }
+
+    uint64_t bound(uint64_t, uint64_t, uint64_t, uint64_t f_dt)const{
+        return f_dt;
+    }
+
+    size_type serialize(std::ostream&, sdsl::structure_tree_node* v=nullptr, std::string name="")const{
+        sdsl::structure_tree_node* child = sdsl::structure_tree::add_child(v, name, sdsl::util::class_name(*this));
+        sdsl::structure_tree::add_size(child, 0);
+        return 0;
+    }
+
+    void load(std::istream&){}
+};
+
+/*! Upper bounds for the frequency of a term in the documents below a
+ *  node of the WT over the D array. For each term which occurs at least
+ *  t_min_occ times, the maximal f_dt of the documents in each node of the
+ *  first t_levels levels of the WT is stored (as complete binary tree in
+ *  level order). Nodes deeper in the tree use the bound of their ancestor
+ *  on the last stored level. The bound at the root equals the maximal
+ *  term frequency of the term, as stored in KEY_MAXTF for idx_d1r1mtf.
+ */
+template<uint32_t t_levels=6, uint64_t t_min_occ=4096>
+class tf_bounds{
+public:
+    typedef sdsl::int_vector<>::size_type size_type;
+    static const bool enabled = true;
+private:
+    uint64_t           m_levels = 0;    // deepest level with stored bounds
+    uint64_t           m_nodes = 0;     // nodes per term
+    sdsl::int_vector<> m_ids;           // sorted ids of the bounded terms
+    sdsl::int_vector<> m_bounds;        // m_nodes bounds per term
+public:
+    tf_bounds() = default;
+
+    /*! Builds the bounds from the CSA and the D array, whose WT has
+     *  max_level levels below the root.
+     */
+    template<class t_csa>
+    tf_bounds(const t_csa& csa, sdsl::int_vector_buffer<>& darray, uint64_t max_level){
+        m_levels = std::min((uint64_t)t_levels, max_level);
+        m_nodes = (2ULL<<m_levels)-1;
+        std::vector<uint64_t> ids;
+        std::vector<uint64_t> bounds;
+        std::vector<uint64_t> docs;
+        for (size_type c=1; c<csa.sigma; ++c){
+            uint64_t sp = csa.C[c], ep = csa.C[c+1]-1;
+            if ( ep-sp+1 < t_min_occ ){
+                continue;
+            }
+            ids.push_back(csa.comp2char[c]);
+            size_type offset = bounds.size();
+            bounds.resize(offset+m_nodes, 0);
+            uint64_t* b = bounds.data()+offset+(1ULL<<m_levels)-1; // last level
+            docs.resize(ep-sp+1);
+            for (uint64_t i=sp; i<=ep; ++i){
+                docs[i-sp] = darray[i];
+            }
+            std::sort(docs.begin(), docs.end());
+            for (size_type i=0, j=0; i<docs.size(); i=j){
+                while ( j<docs.size() and docs[j]==docs[i] ){
+                    ++j;
+                }
+                uint64_t& x = b[docs[i] >> (max_level-m_levels)];
+                x = std::max(x, (uint64_t)(j-i));
+            }
+            for (uint64_t l=m_levels; l>0; --l){
+                uint64_t* p = bounds.data()+offset+(1ULL<<(l-1))-1;
+                uint64_t* q = bounds.data()+offset+(1ULL<<l)-1;
+                for (size_type s=0; s < (1ULL<<(l-1)); ++s){
+                    p[s] = std::max(q[2*s], q[2*s+1]);
+                }
+            }
+        }
+        m_ids = sdsl::int_vector<>(ids.size());
+        std::copy(ids.begin(), ids.end(), m_ids.begin());
+        sdsl::util::bit_compress(m_ids);
+        m_bounds = sdsl::int_vector<>(bounds.size());
+        std::copy(bounds.begin(), bounds.end(), m_bounds.begin());
+        sdsl::util::bit_compress(m_bounds);
+    }
+
+    //! Number of WT levels below the root for which bounds are stored.
+    uint64_t levels()const{
+        return m_levels;
+    }
+
+    //! Row of a single-term token in the table (starting at 1), or 0 if it has no bounds.
+    uint64_t row(const std::vector<uint64_t>& ids)const{
+        if ( ids.size() != 1 ){
+            return 0;
+        }
+        auto itr = std::lower_bound(m_ids.begin(), m_ids.end(), ids[0]);
+        if ( itr == m_ids.end() or *itr != ids[0] ){
+            return 0;
+        }
+        return (itr - m_ids.begin()) + 1;
+    }
+
+    //! Bound for f_dt of the term in row in node (level, sym) which contains f_dt occurrences.
+    uint64_t bound(uint64_t row, uint64_t level, uint64_t sym, uint64_t f_dt)const{
+        if ( row == 0 ){
+            return f_dt;
+        }
+        uint64_t l = std::min(level, m_levels);
+        uint64_t b = m_bounds[(row-1)*m_nodes + (1ULL<<l)-1 + (sym >> (level-l))];
+        return std::min(b, f_dt);
+    }
+
+    size_type serialize(std::ostream& out, sdsl::structure_tree_node* v=nullptr, std::string name="")const{
+        using namespace sdsl;
+        structure_tree_node* child = structure_tree::add_child(v, name, util::class_name(*this));
+        size_type written_bytes = 0;
+        written_bytes += write_member(m_levels, out, child, "levels");
+        written_bytes += write_member(m_nodes, out, child, "nodes");
+        written_bytes += m_ids.serialize(out, child, "ids");
+        written_bytes += m_bounds.serialize(out, child, "bounds");
+        structure_tree::add_size(child, written_bytes);
+        return written_bytes;
+    }
+
+    void load(std::istream& in){
+        sdsl::read_member(m_levels, in);
+        sdsl::read_member(m_nodes, in);
+        m_ids.load(in);
+        m_bounds.load(in);
+    }
+};
+
+} // end namespace surf
+
+#endif
@@ -0,0 +1,344 @@
+#ifndef SURF_TOPK_LISTS_HPP
+#define SURF_TOPK_LISTS_HPP
+
+#include "sdsl/int_vector.hpp"
+#include "sdsl/int_vector_buffer.hpp"
+#include "surf/config.hpp"
+#include "surf/construct_darray.hpp"
+#include "surf/doc_perm.hpp"
+#include "surf/query.hpp"
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <limits>
+#include <string>
+#include <tuple>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace surf{
+
+//! Statistics of a query term, as passed to the ranker.
+struct topk_term{
+    uint64_t id;   // term id, or topk_term::phrase for phrases
+    uint64_t f_qt;
+    uint64_t f_Dt;
+    uint64_t F_Dt;
+
+    static const uint64_t phrase = std::numeric_limits<uint64_t>::max();
+};
+
+//! Placeholder of an index without top-K lists; answers nothing.
+struct no_topk_lists{
+    typedef sdsl::int_vector<>::size_type size_type;
+    static const bool enabled = false;
+
+    uint64_t K()const{
+        return 0;
+    }
+
+    size_type size()const{
+        return 0;
+    }
+
+    template<class t_ranker>
+    bool answer(const t_ranker&, const topk_term&, size_t, bool, result&)const{
+        return false;
+    }
+
+    template<class t_ranker>
+    double threshold(const t_ranker&, const std::vector<topk_term>&, size_t, bool)const{
+        return std::numeric_limits<double>::lowest();
+    }
+
+    size_type serialize(std::ostream&, sdsl::structure_tree_node* v=nullptr, std::string name="")const{
+        sdsl::structure_tree_node* child = sdsl::structure_tree::add_child(v, name, sdsl::util::class_name(*this));
+        sdsl::structure_tree::add_size(child, 0);
+        return 0;
+    }
+
+    void load(std::istream&){}
+};
+
+/*! Materialised top-K lists of the heavy terms of a collection, i.e. the
+ *  terms which occur in at least 1/df_ratio of the documents. For each
+ *  heavy term the K documents with the highest single-term score
+ *  (f_qt=1) are stored with their f_dt, in decreasing score order. The
+ *  lists depend on the ranker, so they are stored under a key per ranker
+ *  (see topk_lists_key).
+ *
+ *  A list answers a single-term query for k <= K directly. For other
+ *  queries, the documents of the lists of the heavy query terms give
+ *  lower bounds on the final scores, assuming that the contribution of a
+ *  term is never negative, which holds for the rankers of this library.
+ *  The k-th best bound is an initial threshold for the top-k search.
+ *
+ *  Equal scores are ordered as the search of the index orders them, so
+ *  that a query answered from a list gets the result of the search. The
+ *  lists are built from postings in that order (see select).
+ */
+class topk_lists{
+public:
+    typedef sdsl::int_vector<>::size_type size_type;
+    typedef std::pair<uint64_t, uint64_t> posting_type; // (doc id, f_dt)
+    static const bool enabled = true;
+    static const uint64_t default_K = 1000;
+    static const uint64_t default_df_ratio = 64;
+    static constexpr double threshold_slack = 1e-9;
+private:
+    uint64_t           m_K = 0;
+    sdsl::int_vector<> m_ids;   // sorted ids of the heavy terms
+    sdsl::int_vector<> m_start; // list of m_ids[i] is [m_start[i], m_start[i+1])
+    sdsl::int_vector<> m_docs;
+    sdsl::int_vector<> m_f_dt;
+
+    static sdsl::int_vector<> compress(const std::vector<uint64_t>& v){
+        sdsl::int_vector<> iv(v.size());
+        std::copy(v.begin(), v.end(), iv.begin());
+        sdsl::util::bit_compress(iv);
+        return iv;
+    }
+
+    //! Position of the term in m_ids plus one, or 0 if it has no list
+    size_type row(uint64_t id)const{
+        auto itr = std::lower_bound(m_ids.begin(), m_ids.end(), id);
+        if ( itr == m_ids.end() or *itr != id ){
+            return 0;
+        }
+        return (itr - m_ids.begin()) + 1;
+    }
+
+public:
+    topk_lists() = default;
+
+    /*! Builds the lists from the lists of all postings of the heavy terms.
+     *  ids has to be sorted; lists[i] is the top-K of ids[i] as returned
+     *  by select.
+     */
+    topk_lists(uint64_t K, const std::vector<uint64_t>& ids,
+               const std::vector<std::vector<posting_type>>& lists) : m_K(K){
+        std::vector<uint64_t> start(1, 0), docs, f_dt;
+        for (const auto& list : lists){
+            for (const auto& p : list){
+                docs.push_back(p.first);
+                f_dt.push_back(p.second);
+            }
+            start.push_back(docs.size());
+        }
+        m_ids = compress(ids);
+        m_start = compress(start);
+        m_docs = compress(docs);
+        m_f_dt = compress(f_dt);
+    }
+
+    /*! Builds the lists from the D array of the collection, whose entries
+     *  are document ids in length order (see doc_perm). Equal scores are
+     *  ordered by decreasing length order id, as node_less orders the
+     *  leaves of the WT traversal.
+     */
+    template<class t_csa, class t_df, class t_ranker>
+    topk_lists(const t_csa& csa, const t_df& df, sdsl::int_vector_buffer<>& darray,
+               const doc_perm& docperm, const t_ranker& ranker,
+               uint64_t num_docs, uint64_t K=default_K, uint64_t df_ratio=default_df_ratio){
+        std::vector<uint64_t> ids;
+        std::vector<std::vector<posting_type>> lists;
+        std::vector<uint64_t> docs;
+        for (size_type c=1; c<csa.sigma; ++c){
+            uint64_t sp = csa.C[c], ep = csa.C[c+1]-1;
+            uint64_t f_Dt = std::get<0>(df(sp, ep));
+            if ( f_Dt * df_ratio < num_docs ){
+                continue;
+            }
+            docs.resize(ep-sp+1);
+            for (uint64_t i=sp; i<=ep; ++i){
+                docs[i-sp] = darray[i];
+            }
+            std::sort(docs.begin(), docs.end(), std::greater<uint64_t>());
+            std::vector<posting_type> postings;
+            for (size_type i=0, j=0; i<docs.size(); i=j){
+                while ( j<docs.size() and docs[j]==docs[i] ){
+                    ++j;
+                }
+                postings.emplace_back(docperm.len2id[docs[i]], j-i);
+            }
+            ids.push_back(csa.comp2char[c]);
+            lists.push_back(select(ranker, postings, f_Dt, ep-sp+1, K));
+        }
+        *this = topk_lists(K, ids, lists);
+    }
+
+    /*! Returns the K postings of a term with the highest single-term
+     *  scores, in decreasing score order. Equal scores keep the order of
+     *  postings, which has to be the tie order of the search of the index.
+     */
+    template<class t_ranker>
+    static std::vector<posting_type> select(const t_ranker& ranker, const std::vector<posting_type>& postings,
+                                            uint64_t f_Dt, uint64_t F_Dt, uint64_t K){
+        std::vector<std::pair<double, size_t>> scored; // (score, position in postings)
+        scored.reserve(postings.size());
+        for (size_t i = 0; i < postings.size(); ++i){
+            double W_d = ranker.doc_length(postings[i].first);
+            double score = ranker.calc_doc_weight(W_d)
+                           + ranker.calculate_docscore(1, postings[i].second, f_Dt, F_Dt, W_d, true);
+            scored.emplace_back(score, i);
+        }
+        auto cmp = [](const std::pair<double, size_t>& a, const std::pair<double, size_t>& b){
+            if ( a.first != b.first ){
+                return a.first > b.first;
+            }
+            return a.second < b.second;
+        };
+        size_t n = std::min((size_t)K, scored.size());
+        std::partial_sort(scored.begin(), scored.begin()+n, scored.end(), cmp);
+        std::vector<posting_type> res(n);
+        for (size_t i = 0; i < n; ++i){
+            res[i] = postings[scored[i].second];
+        }
+        return res;
+    }
+
+    uint64_t K()const{
+        return m_K;
+    }
+
+    //! Number of heavy terms.
+    size_type size()const{
+        return m_ids.size();
+    }
+
+    /*! Answers the single-term query t from its list, if t is a heavy
+     *  term with f_qt=1 and the list holds k documents or all documents
+     *  of the term. The scores are the ones a search would compute.
+     *  With profile the list entries read are reported as
+     *  postings_evaluated and the documents of the term as postings_total.
+     */
+    template<class t_ranker>
+    bool answer(const t_ranker& ranker, const topk_term& t, size_t k, bool profile, result& res)const{
+        size_type r = t.id == topk_term::phrase ? 0 : row(t.id);
+        if ( r == 0 or t.f_qt != 1 ){
+            return false;
+        }
+        uint64_t b = m_start[r-1], e = m_start[r];
+        if ( e-b < k and e-b < t.f_Dt ){
+            return false;
+        }
+        res.list.clear();
+        for (uint64_t i = b; i < e and res.list.size() < k; ++i){
+            double W_d = ranker.doc_length(m_docs[i]);
+            double score = 1 * ranker.calc_doc_weight(W_d);
+            score += ranker.calculate_docscore(t.f_qt, m_f_dt[i], t.f_Dt, t.F_Dt, W_d, true);
+            res.list.emplace_back(m_docs[i], score);
+        }
+        if (profile) {
+            res.postings_evaluated = res.list.size();
+            res.postings_total = t.f_Dt;
+        }
+        return true;
+    }
+
+    /*! Returns a score which the k-th best document of the query terms
+     *  exceeds, or the lowest double if the lists do not give one.
+     *  Only documents which are known to contain all terms are used
+     *  for ranked AND queries.
+     */
+    template<class t_ranker>
+    double threshold(const t_ranker& ranker, const std::vector<topk_term>& terms,
+                     size_t k, bool ranked_and)const{
+        const double lowest = std::numeric_limits<double>::lowest();
+        const size_t n = terms.size();
+        if ( k == 0 or m_ids.size() == 0 ){
+            return lowest;
+        }
+        std::unordered_map<uint64_t, std::pair<double, size_t>> bounds; // doc -> (bound, terms)
+        for (const auto& t : terms){
+            size_type r = t.id == topk_term::phrase ? 0 : row(t.id);
+            if ( r == 0 ){
+                if ( ranked_and ){
+                    return lowest;
+                }
+                continue;
+            }
+            for (uint64_t i = m_start[r-1]; i < m_start[r]; ++i){
+                double W_d = ranker.doc_length(m_docs[i]);
+                auto itr = bounds.find(m_docs[i]);
+                if ( itr == bounds.end() ){
+                    itr = bounds.emplace(m_docs[i], std::make_pair(n * ranker.calc_doc_weight(W_d), 0)).first;
+                }
+                itr->second.first += ranker.calculate_docscore(t.f_qt, m_f_dt[i], t.f_Dt, t.F_Dt, W_d, true);
+                itr->second.second++;
+            }
+        }
+        std::vector<double> scores;
+        for (const auto& x : bounds){
+            if ( !ranked_and or x.second.second == n ){
+                scores.push_back(x.second.first);
+            }
+        }
+        if ( scores.size() < k ){
+            return lowest;
+        }
+        std::nth_element(scores.begin(), scores.begin()+(k-1), scores.end(), std::greater<double>());
+        // documents with a score equal to the bound have to stay in the
+        // search, also if the search sums up the score in another order
+        double bound = scores[k-1];
+        return bound - threshold_slack * std::max(1.0, std::fabs(bound));
+    }
+
+    size_type serialize(std::ostream& out, sdsl::structure_tree_node* v=nullptr, std::string name="")const{
+        using namespace sdsl;
+        structure_tree_node* child = structure_tree::add_child(v, name, util::class_name(*this));
+        size_type written_bytes = 0;
+        written_bytes += write_member(m_K, out, child, "K");
+        written_bytes += m_ids.serialize(out, child, "ids");
+        written_bytes += m_start.serialize(out, child, "start");
+        written_bytes += m_docs.serialize(out, child, "docs");
+        written_bytes += m_f_dt.serialize(out, child, "f_dt");
+        structure_tree::add_size(child, written_bytes);
+        return written_bytes;
+    }
+
+    void load(std::istream& in){
+        sdsl::read_member(m_K, in);
+        m_ids.load(in);
+        m_start.load(in);
+        m_docs.load(in);
+        m_f_dt.load(in);
+    }
+};
+
+/*! Cache key of the top-K lists for ranker t_ranker. The tie order of
+ *  the lists depends on the search of the index, so indexes which order
+ *  ties differently use different keys (KEY_TOPKLISTS for the WT
+ *  indexes, KEY_TOPKLISTS_INVFILE for idx_invfile).
+ */
+template<class t_ranker>
+std::string topk_lists_key(const std::string& key=KEY_TOPKLISTS){
+    return key + "_" + sdsl::util::class_to_hash(t_ranker());
+}
+
+//! Builds the top-K lists for t_ranker from the D array, if they are not cached yet.
+template<class t_csa, class t_df, class t_ranker>
+void construct_topk_lists(sdsl::cache_config& cc)
+{
+    using namespace sdsl;
+    if ( cache_file_exists(topk_lists_key<t_ranker>(), cc) ){
+        return;
+    }
+    construct_darray<t_csa::alphabet_type::int_width>(cc);
+    t_csa csa;
+    t_df df;
+    doc_perm docperm;
+    load_from_cache(csa, surf::KEY_CSA, cc, true);
+    load_from_cache(df, surf::KEY_SADADF, cc, true);
+    load_from_cache(docperm, surf::KEY_DOCPERM, cc);
+    t_ranker ranker(cc);
+    int_vector_buffer<> darray(cache_file_name(surf::KEY_DARRAY, cc));
+    topk_lists lists(csa, df, darray, docperm, ranker, docperm.len2id.size());
+    std::cout << "topk lists: " << lists.size() << " heavy terms" << std::endl;
+    store_to_cache(lists, topk_lists_key<t_ranker>(), cc);
+}
+
+} // end namespace surf
+
+#endif
@@ -0,0 +1,132 @@
+#ifndef SURF_TRAVERSAL_HEAP_HPP
+#define SURF_TRAVERSAL_HEAP_HPP
+
+#include <cstdint>
+#include <vector>
+#include <utility>
+#include <algorithm>
+
+namespace surf{
+
+/*! Max-heap used by the best-first wavelet tree traversals.
+ *  The states are stored in a slab and are never moved by the heap
+ *  operations; the t_arity-ary heap only orders small {score, slot} keys.
+ *  Keys with equal score are ordered by operator< of the states, so the
+ *  pop order is the same as the one of a std::priority_queue<t_state>.
+ *  Slots of popped states are reused and the buffers keep their capacity
+ *  after clear(), so a heap can serve many queries without allocating.
+ */
+template<typename t_state, uint32_t t_arity=4>
+class traversal_heap{
+    static_assert(t_arity >= 2, "arity of traversal_heap must be at least 2.");
+public:
+    typedef uint64_t size_type;
+private:
+    struct key_type{
+        double   score;
+        uint64_t slot;
+    };
+    std::vector<t_state>   m_slab;
+    std::vector<uint64_t>  m_free; // unused slots in m_slab
+    std::vector<key_type>  m_keys;
+
+    bool less(const key_type& a, const key_type& b)const{
+        if ( a.score != b.score ){
+            return a.score < b.score;
+        }
+        return m_slab[a.slot] < m_slab[b.slot];
+    }
+
+    void sift_up(size_type i){
+        key_type x = m_keys[i];
+        while ( i > 0 ){
+            size_type p = (i-1)/t_arity;
+            if ( !less(m_keys[p], x) ){
+                break;
+            }
+            m_keys[i] = m_keys[p];
+            i = p;
+        }
+        m_keys[i] = x;
+    }
+
+    void sift_down(size_type i){
+        const size_type n = m_keys.size();
+        key_type x = m_keys[i];
+        while ( true ){
+            size_type c = t_arity*i+1;
+            if ( c >= n ){
+                break;
+            }
+            size_type c_end = std::min(c+t_arity, n);
+            size_type m = c;
+            for (++c; c < c_end; ++c){
+                if ( less(m_keys[m], m_keys[c]) ){
+                    m = c;
+                }
+            }
+            if ( !less(x, m_keys[m]) ){
+                break;
+            }
+            m_keys[i] = m_keys[m];
+            i = m;
+        }
+        m_keys[i] = x;
+    }
+
+public:
+    bool empty()const{
+        return m_keys.empty();
+    }
+
+    size_type size()const{
+        return m_keys.size();
+    }
+
+    void clear(){
+        m_slab.clear();
+        m_free.clear();
+        m_keys.clear();
+    }
+
+    void reserve(size_type n){
+        m_slab.reserve(n);
+        m_keys.reserve(n);
+    }
+
+    //! Construct a state in the slab and insert it into the heap.
+    template<class... t_args>
+    void emplace(t_args&&... args){
+        uint64_t slot;
+        if ( !m_free.empty() ){
+            slot = m_free.back();
+            m_free.pop_back();
+            m_slab[slot] = t_state(std::forward<t_args>(args)...);
+        } else {
+            slot = m_slab.size();
+            m_slab.emplace_back(std::forward<t_args>(args)...);
+        }
+        m_keys.push_back({m_slab[slot].score, slot});
+        sift_up(m_keys.size()-1);
+    }
+
+    const t_state& top()const{
+        return m_slab[m_keys[0].slot];
+    }
+
+    //! Remove the maximal state from the heap and move it out.
+    t_state pop(){
+        uint64_t slot = m_keys[0].slot;
+        m_keys[0] = m_keys.back();
+        m_keys.pop_back();
+        if ( !m_keys.empty() ){
+            sift_down(0);
+        }
+        m_free.push_back(slot);
+        return std::move(m_slab[slot]);
+    }
+};
+
+} // end namespace surf
+
+#endif
@@ -0,0 +1,180 @@
+#ifndef SURF_WORK_STEALING_POOL_HPP
+#define SURF_WORK_STEALING_POOL_HPP
+
+#include <cstdint>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <algorithm>
+
+namespace surf{
+
+/*! A simple work-stealing pool for a fixed set of independent tasks.
+ *  The task ids [0,n) are split into contiguous blocks, one per thread.
+ *  A thread takes tasks from the front of its own queue and, once it
+ *  runs dry, steals from the back of the queues of the other threads.
+ *  No new tasks are created while running, so a thread terminates as
+ *  soon as it finds all queues empty.
+ *
+ *  An instance of the pool keeps its worker threads between jobs, for
+ *  jobs which are too short to start threads for each of them, e.g. the
+ *  subtrees of a single query (see submit).
+ */
+class work_stealing_pool{
+    struct task_queue{
+        std::mutex         mtx;
+        std::deque<size_t> tasks;
+    };
+    struct job{
+        size_t n;
+        size_t next = 0; // next task which is handed out
+        size_t done = 0; // finished tasks
+        const std::function<void(size_t)>* f;
+    };
+
+    std::vector<std::thread> m_workers;
+    std::deque<job*>         m_jobs; // jobs with tasks which are not handed out yet
+    std::mutex               m_mtx;
+    std::condition_variable  m_work_cv;
+    std::condition_variable  m_done_cv;
+    bool                     m_stop = false;
+
+public:
+    work_stealing_pool() = default;
+    work_stealing_pool(const work_stealing_pool&) = delete;
+    work_stealing_pool& operator=(const work_stealing_pool&) = delete;
+
+    //! Starts num_threads-1 workers; the thread which submits a job is the last one.
+    explicit work_stealing_pool(size_t num_threads){
+        for (size_t t=1; t<num_threads; ++t){
+            m_workers.emplace_back([this](){
+                std::unique_lock<std::mutex> lock(m_mtx);
+                while ( true ){
+                    m_work_cv.wait(lock, [this](){ return m_stop or !m_jobs.empty(); });
+                    if ( m_stop ){
+                        return;
+                    }
+                    work(m_jobs.front(), lock);
+                }
+            });
+        }
+    }
+
+    ~work_stealing_pool(){
+        {
+            std::lock_guard<std::mutex> lock(m_mtx);
+            m_stop = true;
+        }
+        m_work_cv.notify_all();
+        for (auto& t : m_workers){
+            t.join();
+        }
+    }
+
+    //! Number of threads which work on a submitted job.
+    size_t threads()const{
+        return m_workers.size()+1;
+    }
+
+    /*! Calls f(task_id) for every task_id in [0,n) on the workers and the
+     *  calling thread, and returns once all calls are finished. The tasks
+     *  are handed out in increasing order. Several threads may submit
+     *  jobs at the same time; the workers serve them in order of
+     *  submission and each submitter works on its own job.
+     */
+    void submit(size_t n, const std::function<void(size_t)>& f){
+        job j;
+        j.n = n;
+        j.f = &f;
+        std::unique_lock<std::mutex> lock(m_mtx);
+        if ( n == 0 ){
+            return;
+        }
+        m_jobs.push_back(&j);
+        m_work_cv.notify_all();
+        work(&j, lock);
+        m_done_cv.wait(lock, [&j](){ return j.done == j.n; });
+    }
+
+    //! Calls f(task_id, thread_id) for every task_id in [0,n).
+    template<class t_func>
+    static void run(size_t n, size_t num_threads, t_func f){
+        num_threads = std::max((size_t)1, std::min(num_threads, n));
+        if ( num_threads == 1 ){
+            for (size_t i=0; i<n; ++i){
+                f(i, 0);
+            }
+            return;
+        }
+        std::vector<task_queue> queues(num_threads);
+        for (size_t t=0; t<num_threads; ++t){
+            size_t begin = (n*t)/num_threads;
+            size_t end   = (n*(t+1))/num_threads;
+            for (size_t i=begin; i<end; ++i){
+                queues[t].tasks.push_back(i);
+            }
+        }
+        auto worker = [&queues,&f,num_threads](size_t tid){
+            size_t task;
+            while ( next_task(queues, tid, num_threads, task) ){
+                f(task, tid);
+            }
+        };
+        std::vector<std::thread> threads;
+        for (size_t t=1; t<num_threads; ++t){
+            threads.emplace_back(worker, t);
+        }
+        worker(0);
+        for (auto& t : threads){
+            t.join();
+        }
+    }
+
+private:
+    /*! Runs tasks of job j until all of them are handed out. Called with
+     *  m_mtx locked, which is released while a task runs.
+     */
+    void work(job* j, std::unique_lock<std::mutex>& lock){
+        while ( j->next < j->n ){
+            size_t task = j->next++;
+            if ( j->next == j->n ){
+                m_jobs.erase(std::find(m_jobs.begin(), m_jobs.end(), j));
+            }
+            lock.unlock();
+            (*j->f)(task);
+            lock.lock();
+            if ( ++j->done == j->n ){
+                m_done_cv.notify_all();
+            }
+        }
+    }
+
+    static bool next_task(std::vector<task_queue>& queues, size_t tid,
+                          size_t num_threads, size_t& task){
+        {
+            std::lock_guard<std::mutex> lock(queues[tid].mtx);
+            if ( !queues[tid].tasks.empty() ){
+                task = queues[tid].tasks.front();
+                queues[tid].tasks.pop_front();
+                return true;
+            }
+        }
+        for (size_t i=1; i<num_threads; ++i){
+            auto& victim = queues[(tid+i) % num_threads];
+            std::lock_guard<std::mutex> lock(victim.mtx);
+            if ( !victim.tasks.empty() ){
+                task = victim.tasks.back();
+                victim.tasks.pop_back();
+                return true;
+            }
+        }
+        return false;
+    }
+};
+
+} // end namespace surf
+
+#endif
@@ -0,0 +1,200 @@
+#ifndef SURF_WT_BATCH_HPP
+#define SURF_WT_BATCH_HPP
+
+#include "sdsl/wavelet_trees.hpp"
+#include "surf/rank_support_prefetch.hpp"
+#include <array>
+
+namespace surf{
+
+using range_type = sdsl::range_type;
+
+/*! Order of the WT nodes which breaks score ties in the traversals:
+ *  by level, then by symbol. For wt_int this is the order of the node
+ *  offsets. The nodes of wm_int are not stored in symbol order, so
+ *  comparing offsets would make its results differ from wt_int on ties.
+ */
+template<class t_node>
+bool node_less(const t_node& v, const t_node& u){
+    if ( v.level != u.level ){
+        return v.level < u.level;
+    }
+    return v.sym < u.sym;
+}
+
+//! Prefetches the word holding bit i of a bitvector.
+template<class t_bv>
+inline void prefetch_bit(const t_bv&, uint64_t){
+    // no word addressable storage
+}
+
+inline void prefetch_bit(const sdsl::bit_vector& bv, uint64_t i){
+    __builtin_prefetch(bv.data() + (i>>6));
+}
+
+//! Prefetches the rank sample read by rank(i), if the rank support exposes it.
+template<class t_rank>
+auto prefetch_rank_support(const t_rank& rs, uint64_t i, int)
+    -> decltype(rs.prefetch(i), void())
+{
+    rs.prefetch(i);
+}
+
+template<class t_rank>
+void prefetch_rank_support(const t_rank&, uint64_t, long) {}
+
+//! Prefetches the words read by a rank lookup at position i.
+template<class t_bv, class t_rank>
+inline void prefetch_rank(const t_bv& bv, const t_rank& rs, uint64_t i){
+    prefetch_bit(bv, i);
+    prefetch_rank_support(rs, i, 0);
+}
+
+/*! A wt_int which splits the expansion of a node into separate steps,
+ *  so that a traversal can expand the ranges of all query terms in a
+ *  node (and in the nodes of a second WT) in one pass:
+ *   1. prefetch(v) and prefetch(v, r) for all ranges r, which touch the
+ *      words needed by the rank lookups of step 2 and 3,
+ *   2. expand_node(v, v_rank), which also returns the rank of the start
+ *      of v,
+ *   3. expand_range(v, r, v_rank) for all ranges r, which resolve two
+ *      rank lookups instead of three in expand(v, r).
+ *  Step 1 prefetches the bit words for plain bit_vectors and the rank
+ *  samples if the rank support exposes them (rank_support_prefetch).
+ *  sdsl keeps the storage of rrr_vector and of the rank supports of
+ *  bit_vector private, so a WT over rrr_vector or with rank_support_v5
+ *  prefetches only the bits, or nothing. With bit_vector_il the samples
+ *  are interleaved with the bits, so a lookup touches one cache line.
+ */
+template<class t_bitvector   = sdsl::bit_vector,
+         class t_rank        = typename t_bitvector::rank_1_type,
+         class t_select      = typename t_bitvector::select_1_type,
+         class t_select_zero = typename t_bitvector::select_0_type>
+class wt_int_batch : public sdsl::wt_int<t_bitvector, t_rank, t_select, t_select_zero>{
+public:
+    typedef sdsl::wt_int<t_bitvector, t_rank, t_select, t_select_zero> base_type;
+    typedef typename base_type::size_type size_type;
+    typedef typename base_type::node_type node_type;
+
+    using base_type::base_type;
+    using base_type::expand;
+
+    void prefetch(const node_type& v)const{
+        prefetch_rank(this->m_tree, this->m_tree_rank, v.offset);
+        prefetch_rank(this->m_tree, this->m_tree_rank, v.offset + v.size);
+    }
+
+    void prefetch(const node_type& v, const range_type& r)const{
+        prefetch_rank(this->m_tree, this->m_tree_rank, v.offset + r.first);
+        prefetch_rank(this->m_tree, this->m_tree_rank, v.offset + r.second + 1);
+    }
+
+    //! expand(v); v_rank is set to the number of ones before v.
+    std::array<node_type, 2> expand_node(const node_type& v, size_type& v_rank)const{
+        v_rank = this->m_tree_rank(v.offset);
+        size_type ones = this->m_tree_rank(v.offset + v.size) - v_rank;
+        size_type zeros = v.size - ones;
+        node_type v_left = v, v_right = v;
+        v_left.offset = v.offset + this->m_size;
+        v_left.size = zeros;
+        v_left.level = v.level + 1;
+        v_left.sym = v.sym << 1;
+        v_right.offset = v.offset + this->m_size + zeros;
+        v_right.size = ones;
+        v_right.level = v.level + 1;
+        v_right.sym = (v.sym << 1) | 1;
+        return {{v_left, v_right}};
+    }
+
+    //! expand(v, r) with v_rank as returned by expand_node(v, v_rank).
+    std::array<range_type, 2> expand_range(const node_type& v, const range_type& r, size_type v_rank)const{
+        size_type sp_rank = this->m_tree_rank(v.offset + r.first);
+        size_type right_size = this->m_tree_rank(v.offset + r.second + 1) - sp_rank;
+        size_type left_size = (r.second - r.first + 1) - right_size;
+        size_type right_sp = sp_rank - v_rank;
+        size_type left_sp = r.first - right_sp;
+        return {{range_type(left_sp, left_sp + left_size - 1),
+                 range_type(right_sp, right_sp + right_size - 1)}};
+    }
+};
+
+/*! Batched expansion steps for any WT. WTs without the steps of
+ *  wt_int_batch fall back to expand and do not prefetch.
+ */
+template<class t_wt>
+auto wt_prefetch(const t_wt& wt, const typename t_wt::node_type& v, int)
+    -> decltype(wt.prefetch(v), void())
+{
+    wt.prefetch(v);
+}
+
+template<class t_wt>
+void wt_prefetch(const t_wt&, const typename t_wt::node_type&, long) {}
+
+template<class t_wt>
+void wt_prefetch(const t_wt& wt, const typename t_wt::node_type& v)
+{
+    wt_prefetch(wt, v, 0);
+}
+
+template<class t_wt>
+auto wt_prefetch(const t_wt& wt, const typename t_wt::node_type& v, const range_type& r, int)
+    -> decltype(wt.prefetch(v, r), void())
+{
+    wt.prefetch(v, r);
+}
+
+template<class t_wt>
+void wt_prefetch(const t_wt&, const typename t_wt::node_type&, const range_type&, long) {}
+
+template<class t_wt>
+void wt_prefetch(const t_wt& wt, const typename t_wt::node_type& v, const range_type& r)
+{
+    wt_prefetch(wt, v, r, 0);
+}
+
+template<class t_wt>
+auto wt_expand_node(const t_wt& wt, const typename t_wt::node_type& v, uint64_t& v_rank, int)
+    -> decltype(wt.expand_node(v, v_rank))
+{
+    return wt.expand_node(v, v_rank);
+}
+
+template<class t_wt>
+auto wt_expand_node(const t_wt& wt, const typename t_wt::node_type& v, uint64_t&, long)
+    -> decltype(wt.expand(v))
+{
+    return wt.expand(v);
+}
+
+template<class t_wt>
+auto wt_expand_node(const t_wt& wt, const typename t_wt::node_type& v, uint64_t& v_rank)
+    -> decltype(wt_expand_node(wt, v, v_rank, 0))
+{
+    return wt_expand_node(wt, v, v_rank, 0);
+}
+
+template<class t_wt>
+auto wt_expand_range(const t_wt& wt, const typename t_wt::node_type& v, const range_type& r, uint64_t v_rank, int)
+    -> decltype(wt.expand_range(v, r, v_rank))
+{
+    return wt.expand_range(v, r, v_rank);
+}
+
+template<class t_wt>
+std::array<range_type, 2>
+wt_expand_range(const t_wt& wt, const typename t_wt::node_type& v, const range_type& r, uint64_t, long)
+{
+    return wt.expand(v, r);
+}
+
+template<class t_wt>
+std::array<range_type, 2>
+wt_expand_range(const t_wt& wt, const typename t_wt::node_type& v, const range_type& r, uint64_t v_rank)
+{
+    return wt_expand_range(wt, v, r, v_rank, 0);
+}
+
+} // end namespace surf
+
+#endif
@@ -0,0 +1,829 @@
+#ifndef SURF_WT_SEARCH_HPP
+#define SURF_WT_SEARCH_HPP
+
+#include "sdsl/wavelet_trees.hpp"
+#include "surf/config.hpp"
+#include "surf/query.hpp"
+#include "surf/doc_perm.hpp"
+#include "surf/search_arena.hpp"
+#include "surf/traversal_heap.hpp"
+#include "surf/wt_batch.hpp"
+#include "surf/shared_topk.hpp"
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <limits>
+#include <queue>
+#include <random>
+#include <type_traits>
+#include <vector>
+
+namespace surf{
+
+//! Placeholder for the second WT of the traversal of idx_d.
+struct no_wt{
+    struct node_type{};
+
+    node_type root()const{
+        return node_type();
+    }
+
+    std::array<node_type, 2> expand(const node_type&)const{
+        return {{node_type(), node_type()}};
+    }
+
+    std::array<range_type, 2> expand(const node_type&, const range_type& r)const{
+        return {{r, r}};
+    }
+};
+
+//! Ranges of a query term in the document WT (v) and in the second WT (w).
+struct wt_term_ranges{
+    range_type v;
+    range_type w;
+};
+
+/*! Range storage of the traversal states for exactly t_n query terms.
+ *  The ranges are stored in the state itself.
+ */
+template<size_t t_n>
+struct fixed_range_store{
+    typedef std::array<wt_term_ranges, t_n> handle_type;
+
+    static constexpr size_t n(){
+        return t_n;
+    }
+
+    handle_type alloc(){
+        return handle_type();
+    }
+
+    void release(const handle_type&){}
+
+    wt_term_ranges* at(handle_type& h){
+        return h.data();
+    }
+};
+
+/*! Range storage of the traversal states for an arbitrary number of
+ *  query terms. The state only holds the offset of its ranges in an arena.
+ */
+struct arena_range_store{
+    typedef uint64_t handle_type;
+
+    search_arena<wt_term_ranges>& m_arena;
+    size_t                        m_n;
+
+    arena_range_store(search_arena<wt_term_ranges>& arena, size_t n) : m_arena(arena), m_n(n) {}
+
+    size_t n()const{
+        return m_n;
+    }
+
+    handle_type alloc(){
+        return m_arena.alloc(m_n);
+    }
+
+    void release(handle_type h){
+        m_arena.release(h, m_n);
+    }
+
+    wt_term_ranges* at(handle_type h){
+        return m_arena.at(h);
+    }
+};
+
+/*! Start of a traversal below the root of the document WT: the nodes
+ *  of one of its levels, indexed by symbol, and the ranges of the query
+ *  terms in them. The range of term i in nodes[j] is
+ *  ranges[i*nodes.size()+j].
+ */
+template<class t_node>
+struct level_start{
+    const std::vector<t_node>& nodes;
+    std::vector<range_type>    ranges;
+};
+
+/*! Best-first top-k traversal shared by the WT based indexes.
+ *  The traversal runs over the WT of the (length ordered) document array
+ *  t_wtd and, in lockstep, over a second WT t_wtr, e.g. the WT over the
+ *  repetition array of idx_dr. idx_d uses no_wt as second WT.
+ *  Each state holds one pair of ranges per query term; terms which do not
+ *  occur below the node of a state have an empty v range.
+ *  Queries with up to max_fixed_terms terms run on instantiations for the
+ *  exact number of terms with the ranges in std::arrays, longer ones on
+ *  an arena.
+ *  All ranges of a node, in both WTs, are expanded in one pass: first the
+ *  rank lookups are prefetched, then resolved (see wt_int_batch).
+ *
+ *  t_tf(i, v, ranges) returns the (estimated) frequency of term i in the
+ *  documents below node v which is plugged into the ranker. Let reuse_level
+ *  be the level below which t_tf only depends on the size of the v range.
+ *  The score of a left child which got all ranges of its parent is then
+ *  equal to the parent score and is not recomputed.
+ *
+ *  With term dropping (see set_term_dropping) the traversal removes
+ *  terms from a state in MaxScore fashion: once the k-th score exceeds
+ *  what a document can reach with the terms of smallest contribution
+ *  alone, their ranges are no longer expanded. The contribution of a
+ *  dropped term in the node is kept as a constant in the scores below
+ *  it, and its exact frequency in a leaf is counted with two rank
+ *  queries on t_wtd. This requires that t_wtd is the WT over the D array
+ *  and that m_terms[i].sp_Dt, ep_Dt is the range of term i in its root.
+ *
+ *  Once the subtree of a state holds at most as many documents as results
+ *  are missing, its leaves are enumerated depth-first and scored without
+ *  the heap (bulk mode). They are merged into the result in score order.
+ *
+ *  Several traversals over disjoint subtrees can share a top-k (see
+ *  set_shared_topk), e.g. one per thread in a parallel search.
+ *
+ *  Documents of equal score are ranked as node_less ranks their leaves,
+ *  i.e. by decreasing length order id. A state is only pruned if it
+ *  scores below the k-th score found so far, and after the k-th result
+ *  the leaves of equal score are still collected. So the result does
+ *  not depend on the order in which the traversal reaches tied leaves,
+ *  and equals the one of direct().
+ */
+template<typename t_wtd,
+         typename t_wtr,
+         typename t_ranker,
+         typename t_term,
+         typename t_tf>
+class wt_search{
+public:
+    typedef typename t_wtd::node_type node_type;
+    typedef typename t_wtr::node_type node2_type;
+    static const size_t max_fixed_terms = 6;
+    static const size_t max_drop_terms = 64;
+    static const bool dual = !std::is_same<t_wtr, no_wt>::value;
+private:
+    const t_wtd&               m_wtd;
+    const t_wtr&               m_wtr;
+    const doc_perm&            m_docperm;
+    const t_ranker&            m_ranker;
+    const std::vector<t_term>& m_terms;
+    t_tf                       m_tf;
+    uint64_t                   m_reuse_level;
+    bool                       m_drop_terms = false;
+    shared_topk<node_type>*    m_shared = nullptr;
+
+    template<typename t_handle>
+    struct state_type{
+        double     score;
+        node_type  v;
+        node2_type w;
+        t_handle   h;
+        uint64_t   dropped = 0; // bit i is set if term i was dropped
+        double     frozen = 0;  // bound of the contributions of the dropped terms
+
+        state_type() = default;
+        state_type(double score, const node_type& v, const node2_type& w, const t_handle& h) :
+            score(score), v(v), w(w), h(h) {}
+
+        bool operator<(const state_type& s)const{
+            if ( score != s.score ){
+                return score < s.score;
+            }
+            return node_less(v, s.v);
+        }
+    };
+
+public:
+    wt_search(const t_wtd& wtd, const t_wtr& wtr, const doc_perm& docperm,
+              const t_ranker& ranker, const std::vector<t_term>& terms,
+              t_tf tf, uint64_t reuse_level) :
+        m_wtd(wtd), m_wtr(wtr), m_docperm(docperm), m_ranker(ranker),
+        m_terms(terms), m_tf(tf), m_reuse_level(reuse_level) {}
+
+    /*! Enables dropping of terms in ranked OR queries with at most
+     *  max_drop_terms terms (see the class description).
+     */
+    void set_term_dropping(bool drop){
+        m_drop_terms = drop;
+    }
+
+    /*! Shares the top-k with other traversals. Every leaf which is
+     *  scored is inserted into topk, and states are pruned against its
+     *  threshold as well. The result of the traversal itself then only
+     *  holds the leaves of its own subtrees; the final one is topk.
+     */
+    void set_shared_topk(shared_topk<node_type>* topk){
+        m_shared = topk;
+    }
+
+    /*! Top-k search. v_ranges[i] (w_ranges[i]) is the range of term i
+     *  in the root of the first (second) WT. Nodes whose score does not
+     *  exceed threshold are pruned; the k-th best document has to score
+     *  higher than threshold.
+     */
+    result operator()(const std::vector<range_type>& v_ranges,
+                      const std::vector<range_type>& w_ranges,
+                      size_t k, bool ranked_and, bool profile,
+                      double threshold=std::numeric_limits<double>::lowest())const{
+        return search(v_ranges, w_ranges, nullptr, k, ranked_and, profile, threshold);
+    }
+
+    /*! Top-k search which starts with the nodes of a level of t_wtd
+     *  instead of the root (see level_start). Only for traversals
+     *  without a second WT.
+     */
+    result operator()(const level_start<node_type>& start,
+                      size_t k, bool ranked_and, bool profile,
+                      double threshold=std::numeric_limits<double>::lowest())const{
+        static_assert(!dual, "a traversal over two WTs has to start at the root");
+        return search({}, {}, &start, k, ranked_and, profile, threshold);
+    }
+
+    /*! Top-k search without traversal: the documents in the ranges
+     *  v_ranges are extracted from t_wtd one by one and scored exactly.
+     *  The term frequency of a document is the number of its occurrences
+     *  in the range of the term, which is the value t_tf returns for a
+     *  leaf, so the scores equal the ones of the traversal. Documents of
+     *  equal score are ranked by node_less of their leaves, as in the
+     *  traversal, so both return the same result.
+     *  With profile the number of occurrences read is reported as
+     *  postings_evaluated; no WT node is visited.
+     */
+    result direct(const std::vector<range_type>& v_ranges, size_t k, bool ranked_and,
+                  bool profile)const{
+        typedef std::pair<double, uint64_t> score_sym;  // (score, leaf symbol)
+        const size_t n = m_terms.size();
+        result res;
+        std::vector<std::pair<uint64_t, uint64_t>> occ; // (leaf symbol, term)
+        for (size_t i = 0; i < n; ++i){
+            if ( empty(v_ranges[i]) ){
+                continue;
+            }
+            for (uint64_t j = v_ranges[i].first; j <= v_ranges[i].second; ++j){
+                occ.emplace_back(m_wtd[j], i);
+            }
+        }
+        std::sort(occ.begin(), occ.end());
+        // min-heap of the best k documents; ties are broken by the symbol,
+        // as node_less does for the leaves in the traversal
+        std::priority_queue<score_sym, std::vector<score_sym>, std::greater<score_sym>> topk;
+        std::vector<uint64_t> f_dt(n, 0);
+        for (size_t b = 0, e = 0; b < occ.size() and k > 0; b = e){
+            size_t cnt = 0;
+            for (e = b; e < occ.size() and occ[e].first == occ[b].first; ++e){
+                cnt += (f_dt[occ[e].second]++ == 0);
+            }
+            if ( !ranked_and or cnt == n ){
+                auto doc_len = m_ranker.doc_length(m_docperm.len2id[occ[b].first]);
+                double score = n * m_ranker.calc_doc_weight(doc_len);
+                for (size_t i = 0; i < n; ++i){
+                    if ( f_dt[i] > 0 ){
+                        score += m_ranker.calculate_docscore(
+                                     m_terms[i].f_qt,
+                                     f_dt[i],
+                                     m_terms[i].f_Dt,
+                                     m_terms[i].F_Dt(),
+                                     doc_len,
+                                     true
+                                 );
+                    }
+                }
+                score_sym x(score, occ[b].first);
+                if ( topk.size() < k ){
+                    topk.push(x);
+                } else if ( topk.top() < x ){
+                    topk.pop();
+                    topk.push(x);
+                }
+            }
+            for (size_t j = b; j < e; ++j){
+                f_dt[occ[j].second] = 0;
+            }
+        }
+        res.list.resize(topk.size());
+        for (size_t i = topk.size(); i > 0; --i){
+            res.list[i-1] = doc_score(m_docperm.len2id[topk.top().second], topk.top().first);
+            topk.pop();
+        }
+        if (profile) {
+            res.postings_evaluated = res.postings_total = occ.size();
+        }
+        return res;
+    }
+
+private:
+    result search(const std::vector<range_type>& v_ranges,
+                  const std::vector<range_type>& w_ranges,
+                  const level_start<node_type>* start,
+                  size_t k, bool ranked_and, bool profile, double threshold)const{
+        if ( k == 0 ){
+            return result();
+        }
+        switch ( m_terms.size() ){
+            case 1: return run(fixed_range_store<1>(), v_ranges, w_ranges, start, k, ranked_and, profile, threshold);
+            case 2: return run(fixed_range_store<2>(), v_ranges, w_ranges, start, k, ranked_and, profile, threshold);
+            case 3: return run(fixed_range_store<3>(), v_ranges, w_ranges, start, k, ranked_and, profile, threshold);
+            case 4: return run(fixed_range_store<4>(), v_ranges, w_ranges, start, k, ranked_and, profile, threshold);
+            case 5: return run(fixed_range_store<5>(), v_ranges, w_ranges, start, k, ranked_and, profile, threshold);
+            case 6: return run(fixed_range_store<6>(), v_ranges, w_ranges, start, k, ranked_and, profile, threshold);
+        }
+        static thread_local search_arena<wt_term_ranges> arena;
+        arena.clear();
+        return run(arena_range_store(arena, m_terms.size()), v_ranges, w_ranges, start, k, ranked_and, profile, threshold);
+    }
+
+    //! Score estimate of node v; r holds the ranges of all terms in v
+    double node_score(const node_type& v, const wt_term_ranges* r, size_t n, bool is_leaf,
+                      uint64_t dropped=0, double frozen=0)const{
+        auto min_idx = m_wtd.sym(v) << (m_wtd.max_level - v.level);
+        auto min_doc_len = m_ranker.doc_length(m_docperm.len2id[min_idx]);
+        double score = n * m_ranker.calc_doc_weight(min_doc_len);
+        // the terms are summed up in query order, in a leaf with the exact
+        // contributions of the dropped terms, so that a leaf gets exactly
+        // the score direct() computes for its document
+        for (size_t i = 0; i < n; ++i){
+            if ( dropped & (1ULL<<i) ){
+                if ( !is_leaf ){
+                    continue;
+                }
+                auto sym = m_wtd.sym(v);
+                uint64_t f_dt = m_wtd.rank(m_terms[i].ep_Dt+1, sym) - m_wtd.rank(m_terms[i].sp_Dt, sym);
+                if ( f_dt > 0 ){
+                    score += m_ranker.calculate_docscore(
+                                 m_terms[i].f_qt,
+                                 f_dt,
+                                 m_terms[i].f_Dt,
+                                 m_terms[i].F_Dt(),
+                                 min_doc_len,
+                                 true
+                             );
+                }
+            } else if ( !empty(r[i].v) ){
+                score += m_ranker.calculate_docscore(
+                             m_terms[i].f_qt,
+                             m_tf(i, v, r[i]),
+                             m_terms[i].f_Dt,
+                             m_terms[i].F_Dt(),
+                             min_doc_len,
+                             is_leaf
+                         );
+            }
+        }
+        if ( dropped != 0 and !is_leaf ){
+            return score + frozen;
+        }
+        return score;
+    }
+
+    /*! Drops the terms of state s (with ranges r) in increasing order of
+     *  their contribution to the score of s as long as a document which
+     *  only contains dropped terms scores below theta.
+     */
+    template<typename t_state>
+    void drop_terms(t_state& s, wt_term_ranges* r, size_t n, double theta)const{
+        auto min_idx = m_wtd.sym(s.v) << (m_wtd.max_level - s.v.level);
+        auto min_doc_len = m_ranker.doc_length(m_docperm.len2id[min_idx]);
+        std::array<std::pair<double, size_t>, max_drop_terms> c;
+        size_t m = 0;
+        for (size_t i = 0; i < n; ++i){
+            if ( !empty(r[i].v) ){
+                c[m++] = std::make_pair(m_ranker.calculate_docscore(
+                                            m_terms[i].f_qt,
+                                            m_tf(i, s.v, r[i]),
+                                            m_terms[i].f_Dt,
+                                            m_terms[i].F_Dt(),
+                                            min_doc_len,
+                                            false
+                                        ), i);
+            }
+        }
+        std::sort(c.begin(), c.begin()+m);
+        double bound = n * m_ranker.calc_doc_weight(min_doc_len) + s.frozen;
+        for (size_t j = 0; j < m and bound + c[j].first < theta; ++j){
+            bound += c[j].first;
+            s.frozen += c[j].first;
+            s.dropped |= 1ULL << c[j].second;
+            r[c[j].second].v = r[c[j].second].w = range_type(1, 0);
+        }
+    }
+
+    /*! Expands node (v, w) and maps the ranges r of the n terms to its
+     *  children. The rank lookups are prefetched before they are resolved,
+     *  as far as the WT supports it (see wt_int_batch).
+     *  left_cnt (right_cnt) is set to the number of non-empty ranges of
+     *  the left (right) child.
+     */
+    std::pair<std::array<node_type, 2>, std::array<node2_type, 2>>
+    expand_ranges(const node_type& v, const node2_type& w, const wt_term_ranges* r, size_t n,
+                  wt_term_ranges* left_r, size_t& left_cnt,
+                  wt_term_ranges* right_r, size_t& right_cnt)const{
+        const range_type empty_range(1, 0);
+        wt_prefetch(m_wtd, v);
+        wt_prefetch(m_wtr, w);
+        for (size_t i = 0; i < n; ++i){
+            if ( !empty(r[i].v) ){
+                wt_prefetch(m_wtd, v, r[i].v);
+                if ( dual and !empty(r[i].w) ){
+                    wt_prefetch(m_wtr, w, r[i].w);
+                }
+            }
+        }
+        uint64_t v_rank = 0, w_rank = 0;
+        auto exp_v = wt_expand_node(m_wtd, v, v_rank);
+        auto exp_w = wt_expand_node(m_wtr, w, w_rank);
+        left_cnt = right_cnt = 0;
+        for (size_t i = 0; i < n; ++i){
+            if ( empty(r[i].v) ){
+                left_r[i].v = right_r[i].v = empty_range;
+                continue;
+            }
+            auto exp_r = wt_expand_range(m_wtd, v, r[i].v, v_rank);
+            left_r[i].v = std::get<0>(exp_r);
+            right_r[i].v = std::get<1>(exp_r);
+            left_cnt += !empty(left_r[i].v);
+            right_cnt += !empty(right_r[i].v);
+            if ( dual ){
+                if ( empty(r[i].w) ){
+                    left_r[i].w = right_r[i].w = empty_range;
+                } else {
+                    auto exp_rw = wt_expand_range(m_wtr, w, r[i].w, w_rank);
+                    left_r[i].w = std::get<0>(exp_rw);
+                    right_r[i].w = std::get<1>(exp_rw);
+                }
+            }
+        }
+        return {{{std::get<0>(exp_v), std::get<1>(exp_v)}}, {{std::get<0>(exp_w), std::get<1>(exp_w)}}};
+    }
+
+    /*! Enumerates the leaves below node (v, w) with ranges r depth-first,
+     *  i.e. in symbol order, and calls emit(leaf, ranges, cnt) for each
+     *  leaf which holds a query term (all of them for ranked AND). buf
+     *  has room for the ranges of 2*(max_level-v.level) nodes.
+     */
+    template<typename t_emit>
+    void enumerate_leaves(const node_type& v, const node2_type& w, const wt_term_ranges* r,
+                          size_t n, bool ranked_and, wt_term_ranges* buf, t_emit& emit)const{
+        wt_term_ranges* left_r = buf;
+        wt_term_ranges* right_r = buf + n;
+        size_t left_cnt = 0, right_cnt = 0;
+        auto exp = expand_ranges(v, w, r, n, left_r, left_cnt, right_r, right_cnt);
+        for (size_t c = 0; c < 2; ++c){
+            const node_type& u = exp.first[c];
+            const wt_term_ranges* u_r = c ? right_r : left_r;
+            size_t cnt = c ? right_cnt : left_cnt;
+            if ( m_wtd.empty(u) or cnt == 0 or (ranked_and and cnt < n) ){
+                continue;
+            }
+            if ( m_wtd.is_leaf(u) ){
+                emit(u, u_r, cnt);
+            } else {
+                enumerate_leaves(u, exp.second[c], u_r, n, ranked_and, buf + 2*n, emit);
+            }
+        }
+    }
+
+    template<typename t_store>
+    result run(t_store store, const std::vector<range_type>& v_ranges,
+               const std::vector<range_type>& w_ranges,
+               const level_start<node_type>* start,
+               size_t k, bool ranked_and, bool profile, double threshold)const{
+        typedef typename t_store::handle_type handle_type;
+        typedef state_type<handle_type> state_t;
+        typedef std::priority_queue<double, std::vector<double>, std::greater<double>> pq_min_type;
+        typedef std::pair<double, node_type> leaf_type;
+        constexpr double max_score = std::numeric_limits<double>::max();
+        // the heap is reused across queries of a thread
+        static thread_local traversal_heap<state_t> pq;
+        static thread_local std::vector<wt_term_ranges> bulk_buf;
+        const size_t n = store.n();
+        const range_type empty_range(1, 0);
+        const bool drop = m_drop_terms and !ranked_and and n <= max_drop_terms and k > 0;
+        result res;
+        pq_min_type pq_min; // scores of the best k leaves found so far
+        pq.clear();
+        bulk_buf.resize(2*n*(m_wtd.max_level+1));
+
+        /* Leaves scored in bulk mode, in a heap with the order of the
+         * traversal states. A leaf is final once no state of the heap
+         * precedes it.
+         */
+        std::vector<leaf_type> bulk;
+        auto leaf_less = [](const leaf_type& a, const leaf_type& b){
+            if ( a.first != b.first ){
+                return a.first < b.first;
+            }
+            return node_less(a.second, b.second);
+        };
+        auto precedes = [](const leaf_type& a, const state_t& s){
+            if ( a.first != s.score ){
+                return a.first > s.score;
+            }
+            return node_less(s.v, a.second);
+        };
+
+        // the score a node has to reach to be kept
+        auto cur_threshold = [&](){
+            return m_shared ? std::max(threshold, m_shared->threshold()) : threshold;
+        };
+        // the initial threshold is exceeded by the k-th best document, so
+        // a node which only reaches it is pruned as well
+        auto pruned = [&](double score){
+            return score <= threshold or score < cur_threshold();
+        };
+        // true while a leaf of this score can still be a result: the k-th
+        // score ties are collected as well and resolved at the end
+        auto open = [&](double score){
+            return res.list.size() < k or score >= res.list[k-1].score;
+        };
+
+        /* Evaluates node v, the left (is_left) or right child of a node
+         * with score parent_score. r holds the ranges of v, cnt of them
+         * are non-empty. all_in is true if no range was split between v
+         * and its sibling. dropped and frozen are the dropped terms of the
+         * parent and the bound of their contributions. Returns false if v
+         * can be discarded, otherwise sets its score.
+         */
+        auto eval_node = [&](const node_type& v, const wt_term_ranges* r, size_t cnt,
+                             bool is_left, bool all_in, double parent_score,
+                             uint64_t dropped, double frozen, double& score){
+            if ( cnt == 0 or (ranked_and and cnt < n) ){
+                return false;
+            }
+            bool is_leaf = m_wtd.is_leaf(v);
+            if ( is_left and all_in and !is_leaf and parent_score != max_score
+                 and v.level > m_reuse_level ){
+                score = parent_score;
+            } else {
+                score = node_score(v, r, n, is_leaf, dropped, frozen);
+            }
+            if ( pruned(score) ){
+                return false;
+            }
+            if ( pq_min.size() == k ){ // more than k leaves in score queue
+                if ( score < pq_min.top() ){
+                    return false;
+                }
+                if ( is_leaf ){
+                    pq_min.pop();
+                }
+            }
+            if ( is_leaf ){
+                pq_min.push(score);
+                if ( m_shared ){
+                    m_shared->insert(score, v, m_docperm.len2id[m_wtd.sym(v)]);
+                }
+            }
+            if (profile) res.wt_search_space++;
+            return true;
+        };
+
+        if ( start == nullptr ){
+            state_t root(max_score, m_wtd.root(), m_wtr.root(), store.alloc());
+            wt_term_ranges* r = store.at(root.h);
+            for (size_t i = 0; i < n; ++i){
+                r[i].v = v_ranges[i];
+                r[i].w = dual ? w_ranges[i] : empty_range;
+            }
+            pq.emplace(std::move(root));
+            if(profile) res.wt_search_space++;
+        } else {
+            const size_t nodes = start->nodes.size();
+            for (size_t j = 0; j < nodes; ++j){
+                const node_type& v = start->nodes[j];
+                if ( m_wtd.empty(v) ){
+                    continue;
+                }
+                state_t s(0, v, node2_type(), store.alloc());
+                wt_term_ranges* r = store.at(s.h);
+                size_t cnt = 0;
+                for (size_t i = 0; i < n; ++i){
+                    r[i].v = start->ranges[i*nodes + j];
+                    r[i].w = empty_range;
+                    cnt += !empty(r[i].v);
+                }
+                if ( eval_node(v, r, cnt, false, false, max_score, 0, 0, s.score) ){
+                    pq.emplace(std::move(s));
+                } else {
+                    store.release(s.h);
+                }
+            }
+        }
+
+        while ( true ) {
+            while ( !bulk.empty() and open(bulk.front().first)
+                    and (pq.empty() or precedes(bulk.front(), pq.top())) ){
+                std::pop_heap(bulk.begin(), bulk.end(), leaf_less);
+                res.list.emplace_back(m_docperm.len2id[m_wtd.sym(bulk.back().second)], bulk.back().first);
+                bulk.pop_back();
+            }
+            if ( pq.empty() or !open(pq.top().score) ){
+                break;
+            }
+            state_t s = pq.pop();
+            if ( m_shared and s.score < m_shared->threshold() ){
+                // the other traversals found k better leaves
+                store.release(s.h);
+                break;
+            }
+            // descend without the heap as long as only one child survives
+            // and it would be the next state popped from the heap
+            while ( true ) {
+                if ( m_wtd.is_leaf(s.v) ){
+                    res.list.emplace_back(m_docperm.len2id[m_wtd.sym(s.v)], s.score);
+                    store.release(s.h);
+                    break;
+                }
+                // bulk mode: the subtree of s holds at most as many
+                // documents as results are missing, so its leaves are
+                // scored without the heap
+                uint64_t docs = 0;
+                for (size_t i = 0; i < n; ++i){
+                    docs += size(store.at(s.h)[i].v);
+                }
+                docs = std::min(docs, (uint64_t)1 << (m_wtd.max_level - s.v.level));
+                if ( docs + res.list.size() + bulk.size() <= k ){
+                    auto emit = [&](const node_type& leaf, const wt_term_ranges* r, size_t cnt){
+                        double score;
+                        if ( eval_node(leaf, r, cnt, false, false, max_score,
+                                       s.dropped, s.frozen, score) ){
+                            bulk.emplace_back(score, leaf);
+                            std::push_heap(bulk.begin(), bulk.end(), leaf_less);
+                        }
+                    };
+                    enumerate_leaves(s.v, s.w, store.at(s.h), n, ranked_and, bulk_buf.data(), emit);
+                    store.release(s.h);
+                    break;
+                }
+                if ( drop ){
+                    double theta = cur_threshold();
+                    if ( pq_min.size() == k ){
+                        theta = std::max(theta, pq_min.top());
+                    }
+                    if ( theta > std::numeric_limits<double>::lowest() ){
+                        drop_terms(s, store.at(s.h), n, theta);
+                    }
+                }
+                state_t left(0, node_type(), node2_type(), store.alloc());
+                state_t right(0, node_type(), node2_type(), store.alloc());
+                left.dropped = right.dropped = s.dropped;
+                left.frozen = right.frozen = s.frozen;
+                size_t left_cnt = 0, right_cnt = 0;
+                wt_term_ranges* left_r = store.at(left.h);
+                wt_term_ranges* right_r = store.at(right.h);
+                auto exp = expand_ranges(s.v, s.w, store.at(s.h), n,
+                                         left_r, left_cnt, right_r, right_cnt);
+                left.v = exp.first[0];
+                right.v = exp.first[1];
+                left.w = exp.second[0];
+                right.w = exp.second[1];
+                store.release(s.h);
+
+                bool left_keep = !m_wtd.empty(left.v)
+                                 and eval_node(left.v, left_r, left_cnt,
+                                               true, right_cnt == 0, s.score,
+                                               s.dropped, s.frozen, left.score);
+                bool right_keep = !m_wtd.empty(right.v)
+                                  and eval_node(right.v, right_r, right_cnt,
+                                                false, left_cnt == 0, s.score,
+                                                s.dropped, s.frozen, right.score);
+                if ( !left_keep ){
+                    store.release(left.h);
+                }
+                if ( !right_keep ){
+                    store.release(right.h);
+                }
+                if ( left_keep and right_keep ){
+                    pq.emplace(std::move(left));
+                    pq.emplace(std::move(right));
+                    break;
+                }
+                if ( !left_keep and !right_keep ){
+                    break;
+                }
+                state_t& t = left_keep ? left : right;
+                if ( (!pq.empty() and !(pq.top() < t))
+                     or (!bulk.empty() and precedes(bulk.front(), t)) ){
+                    pq.emplace(std::move(t));
+                    break;
+                }
+                s = std::move(t);
+            }
+        }
+        // states left in the heap are dropped with the arena
+        std::sort(res.list.begin(), res.list.end(), [this](const doc_score& a, const doc_score& b){
+            if ( a.score != b.score ){
+                return a.score > b.score;
+            }
+            return m_docperm.id2len[a.doc_id] > m_docperm.id2len[b.doc_id];
+        });
+        if ( res.list.size() > k ){
+            res.list.resize(k);
+        }
+        return res;
+    }
+};
+
+/*! Decides between the traversal of a WT and the direct extraction of
+ *  the documents in the term ranges (wt_search::direct). A traversal for
+ *  the top-k visits at least about k root-to-leaf paths of the WT, while
+ *  the direct evaluation accesses each occurrence in the ranges once.
+ *  The costs of a node expansion and of an access are measured on the
+ *  WT when the index is loaded; queries whose ranges hold fewer
+ *  occurrences than k paths would cost are evaluated directly. A model
+ *  stored in the cache overrides the measurement (see load_direct_cost),
+ *  so that the choice for a query can be fixed between runs.
+ */
+class direct_cost_model{
+public:
+    typedef uint64_t size_type;
+private:
+    double   m_occ_per_path = 0; // accesses which cost as much as one root-to-leaf path
+    uint64_t m_sink = 0;         // keeps the measured work from being optimized away
+public:
+    template<class t_wt>
+    void calibrate(const t_wt& wt, size_t samples=4096){
+        typedef std::chrono::high_resolution_clock clock;
+        m_occ_per_path = 0;
+        if ( wt.size() == 0 ){
+            return;
+        }
+        std::mt19937_64 rng(4711);
+        std::vector<uint64_t> pos(samples);
+        for (auto& p : pos){
+            p = rng() % wt.size();
+        }
+        auto start = clock::now();
+        for (auto p : pos){
+            m_sink += wt[p];
+        }
+        double t_access = std::chrono::duration<double>(clock::now()-start).count() / samples;
+
+        uint64_t nodes = 0;
+        uint64_t len = std::min((uint64_t)16, (uint64_t)wt.size());
+        start = clock::now();
+        for (size_t s = 0; s < samples; s += wt.max_level + 1){
+            auto v = wt.root();
+            uint64_t sp = std::min(pos[s], wt.size()-len);
+            range_type r(sp, sp+len-1);
+            while ( !wt.is_leaf(v) and !empty(r) ){
+                auto exp_v = wt.expand(v);
+                auto exp_r = wt.expand(v, r);
+                size_t c = empty(std::get<0>(exp_r)) ? 1 : (empty(std::get<1>(exp_r)) ? 0 : (rng() & 1));
+                v = exp_v[c];
+                r = exp_r[c];
+                ++nodes;
+            }
+            m_sink += wt.sym(v);
+        }
+        double t_path = nodes ? std::chrono::duration<double>(clock::now()-start).count() / nodes
+                                * wt.max_level : 0;
+        m_occ_per_path = t_access > 0 ? t_path / t_access : 0;
+    }
+
+    //! True if a query with occ occurrences in its ranges should be evaluated directly.
+    bool direct(uint64_t occ, size_t k)const{
+        return occ <= m_occ_per_path * k;
+    }
+
+    double occ_per_path()const{
+        return m_occ_per_path;
+    }
+
+    size_type serialize(std::ostream& out, sdsl::structure_tree_node* v=nullptr, std::string name="")const{
+        sdsl::structure_tree_node* child = sdsl::structure_tree::add_child(v, name, sdsl::util::class_name(*this));
+        size_type written_bytes = sdsl::write_member(m_occ_per_path, out, child, "occ_per_path");
+        sdsl::structure_tree::add_size(child, written_bytes);
+        return written_bytes;
+    }
+
+    void load(std::istream& in){
+        sdsl::read_member(m_occ_per_path, in);
+    }
+};
+
+//! Cache key of the direct_cost_model of a WT of type t_wt.
+template<class t_wt>
+std::string direct_cost_key(){
+    return KEY_DIRECTCOST + "_" + sdsl::util::class_to_hash(t_wt());
+}
+
+//! Loads the direct_cost_model of wt stored in the cache, or calibrates it on wt if there is none.
+template<class t_wt>
+void load_direct_cost(direct_cost_model& cost, const t_wt& wt, sdsl::cache_config& cc)
+{
+    if ( cache_file_exists(direct_cost_key<t_wt>(), cc) ){
+        load_from_cache(cost, direct_cost_key<t_wt>(), cc);
+    } else {
+        cost.calibrate(wt);
+    }
+}
+
+//! Creates the shared traversal for an index.
+template<typename t_wtd, typename t_wtr, typename t_ranker, typename t_term, typename t_tf>
+wt_search<t_wtd, t_wtr, t_ranker, t_term, t_tf>
+make_wt_search(const t_wtd& wtd, const t_wtr& wtr, const doc_perm& docperm,
+               const t_ranker& ranker, const std::vector<t_term>& terms,
+               t_tf tf, uint64_t reuse_level=std::numeric_limits<uint64_t>::max())
+{
+    return wt_search<t_wtd, t_wtr, t_ranker, t_term, t_tf>(wtd, wtr, docperm, ranker, terms, tf, reuse_level);
+}
+
+} // end namespace surf
+
+#endif
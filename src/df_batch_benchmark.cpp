@@ -0,0 +1,146 @@
+#include <unistd.h>
+#include <stdlib.h>
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <random>
+#include <tuple>
+#include <vector>
+
+#include "sdsl/config.hpp"
+#include "surf/util.hpp"
+#include "surf/config.hpp"
+#include "surf/df_sada.hpp"
+#include "surf/lcp_intervals.hpp"
+
+typedef struct cmdargs {
+    std::string collection_dir;
+    uint64_t batch_size;
+    uint64_t num_intervals;
+    uint64_t scan_words;
+} cmdargs_t;
+
+void
+print_usage(char* program)
+{
+    fprintf(stdout,"%s -c <collection directory> -b <batch size> -n <intervals> -s <scan words>\n",program);
+    fprintf(stdout,"where\n");
+    fprintf(stdout,"  -c <collection directory>  : the directory the collection is stored.\n");
+    fprintf(stdout,"  -b <batch size>  : number of intervals per batch (default 32).\n");
+    fprintf(stdout,"  -n <intervals>  : number of intervals queried (default 1000000).\n");
+    fprintf(stdout,"  -s <scan words>  : words of H scanned before a select (default 8).\n");
+};
+
+cmdargs_t
+parse_args(int argc,char* const argv[])
+{
+    cmdargs_t args;
+    int op;
+    args.collection_dir = "";
+    args.batch_size = 32;
+    args.num_intervals = 1000000;
+    args.scan_words = 8;
+    while ((op=getopt(argc,argv,"c:b:n:s:")) != -1) {
+        switch (op) {
+            case 'c':
+                args.collection_dir = optarg;
+                break;
+            case 'b':
+                args.batch_size = std::strtoull(optarg,NULL,10);
+                break;
+            case 'n':
+                args.num_intervals = std::strtoull(optarg,NULL,10);
+                break;
+            case 's':
+                args.scan_words = std::strtoull(optarg,NULL,10);
+                break;
+            case '?':
+            default:
+                print_usage(argv[0]);
+        }
+    }
+    if (args.collection_dir=="" or args.batch_size==0) {
+        std::cerr << "Missing command line parameters.\n";
+        print_usage(argv[0]);
+        exit(EXIT_FAILURE);
+    }
+    return args;
+}
+
+// Compares df_sada::operator() with df_sada::batch on the intervals of
+// suffix tree nodes, i.e. of phrases which occur in the collection. The
+// intervals of a batch come from one neighbourhood, as those of the
+// phrases of a query: a random window of consecutive nodes in bottom-up
+// order, which is a subtree (extensions of a common prefix) and the
+// siblings next to it.
+int main(int argc,char* const argv[])
+{
+    using clock = std::chrono::high_resolution_clock;
+    using df_type = surf::df_sada<sdsl::rrr_vector<63>>;
+
+    /* parse command line */
+    cmdargs_t args = parse_args(argc,argv);
+
+    /* parse repo */
+    auto cc = surf::parse_collection(args.collection_dir);
+
+    df_type df;
+    if (!sdsl::load_from_cache(df, surf::KEY_SADADF, cc, true)) {
+        std::cerr << "ERROR: no document frequency structure in "
+                  << args.collection_dir << ". Run surf_index first.\n";
+        return EXIT_FAILURE;
+    }
+    std::vector<std::pair<uint64_t,uint64_t>> nodes;
+    {
+        sdsl::int_vector_buffer<> lcp(sdsl::cache_file_name(sdsl::conf::KEY_LCP, cc));
+        surf::lcp_intervals(lcp, [&](const surf::lcp_interval& v){
+            if ( v.lcp > 0 ){
+                nodes.emplace_back(v.lb, v.rb);
+            }
+        });
+    }
+    if (nodes.empty()) {
+        std::cerr << "ERROR: collection has no inner suffix tree nodes.\n";
+        return EXIT_FAILURE;
+    }
+    std::mt19937_64 rng(4711);
+    uint64_t window = std::min(args.batch_size, (uint64_t)nodes.size());
+    std::uniform_int_distribution<uint64_t> node_dist(0, nodes.size()-window);
+    std::vector<std::pair<uint64_t,uint64_t>> ranges(args.num_intervals);
+    for (uint64_t i = 0; i < ranges.size(); i += args.batch_size) {
+        uint64_t first = node_dist(rng);
+        for (uint64_t j = i; j < std::min(i+args.batch_size, (uint64_t)ranges.size()); ++j) {
+            ranges[j] = nodes[first + (j-i) % window];
+        }
+    }
+    std::cout << "nodes = " << nodes.size() << ", intervals = " << ranges.size()
+              << ", batch size = " << args.batch_size << std::endl;
+
+    std::vector<std::tuple<uint64_t,uint64_t,uint64_t>> single;
+    single.reserve(ranges.size());
+    auto start = clock::now();
+    for (const auto& r : ranges) {
+        single.push_back(df(r.first, r.second));
+    }
+    auto single_time = std::chrono::duration_cast<std::chrono::microseconds>(clock::now()-start);
+
+    std::vector<std::tuple<uint64_t,uint64_t,uint64_t>> batched;
+    batched.reserve(ranges.size());
+    start = clock::now();
+    for (uint64_t i = 0; i < ranges.size(); i += args.batch_size) {
+        std::vector<std::pair<uint64_t,uint64_t>> b(ranges.begin()+i,
+            ranges.begin()+std::min(i+args.batch_size, (uint64_t)ranges.size()));
+        auto res = df.batch(b, args.scan_words);
+        batched.insert(batched.end(), res.begin(), res.end());
+    }
+    auto batch_time = std::chrono::duration_cast<std::chrono::microseconds>(clock::now()-start);
+
+    if (single != batched) {
+        std::cerr << "ERROR: batch results differ from the single interval results.\n";
+        return EXIT_FAILURE;
+    }
+    double n = ranges.size();
+    std::cout << std::fixed << std::setprecision(3);
+    std::cout << "single = " << single_time.count()*1000.0/n << " ns per interval" << std::endl;
+    std::cout << "batch  = " << batch_time.count()*1000.0/n << " ns per interval" << std::endl;
+}
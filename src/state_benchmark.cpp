@@ -0,0 +1,246 @@
+#include <unistd.h>
+#include <stdlib.h>
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <random>
+#include <array>
+#include <queue>
+#include <vector>
+
+#include "surf/search_arena.hpp"
+#include "surf/traversal_heap.hpp"
+
+/* Cost of the state handling of the best-first WT traversal, without a
+ * WT: each query pops states from the heap and pushes two children with
+ * the ranges of all terms, as the traversal does when it expands a node.
+ * The states of the original idx_d::search (vectors of term pointers and
+ * ranges, copied into and out of a std::priority_queue) are compared with
+ * the ones of wt_search (ranges inline for up to 6 terms or in a
+ * search_arena, states in a traversal_heap). The scores and range splits
+ * are the same pseudo random sequence for both.
+ */
+
+typedef struct cmdargs {
+    uint64_t max_terms;
+    uint64_t expansions;
+    uint64_t queries;
+} cmdargs_t;
+
+void
+print_usage(char* program)
+{
+    fprintf(stdout,"%s -n <terms> -e <expansions> -q <queries>\n",program);
+    fprintf(stdout,"where\n");
+    fprintf(stdout,"  -n <terms>  : measure queries of 1 to this many terms (default 8).\n");
+    fprintf(stdout,"  -e <expansions>  : node expansions per query (default 10000).\n");
+    fprintf(stdout,"  -q <queries>  : queries per number of terms (default 200).\n");
+};
+
+cmdargs_t
+parse_args(int argc,char* const argv[])
+{
+    cmdargs_t args;
+    int op;
+    args.max_terms = 8;
+    args.expansions = 10000;
+    args.queries = 200;
+    while ((op=getopt(argc,argv,"n:e:q:")) != -1) {
+        switch (op) {
+            case 'n':
+                args.max_terms = std::strtoull(optarg,NULL,10);
+                break;
+            case 'e':
+                args.expansions = std::strtoull(optarg,NULL,10);
+                break;
+            case 'q':
+                args.queries = std::strtoull(optarg,NULL,10);
+                break;
+            case '?':
+            default:
+                print_usage(argv[0]);
+                exit(EXIT_FAILURE);
+        }
+    }
+    return args;
+}
+
+typedef std::pair<uint64_t,uint64_t> range_type;
+
+struct node_type {
+    uint64_t level;
+    uint64_t sym;
+    bool operator<(const node_type& v) const {
+        return level != v.level ? level < v.level : sym < v.sym;
+    }
+};
+
+struct term_type {
+    uint64_t f_qt;
+};
+
+// state of the original idx_d::search
+struct vector_state {
+    double score;
+    node_type v;
+    std::vector<term_type*> t_ptrs;
+    std::vector<range_type> r;
+
+    vector_state() = default;
+    vector_state(double score, const node_type& v, const std::vector<term_type*>& t_ptrs,
+                 const std::vector<range_type>& r) : score(score), v(v), t_ptrs(t_ptrs), r(r) {}
+
+    bool operator<(const vector_state& s) const {
+        return score != s.score ? score < s.score : v < s.v;
+    }
+};
+
+// state of wt_search with the ranges in the state or in an arena
+template<typename t_handle>
+struct handle_state {
+    double score;
+    node_type v;
+    t_handle h;
+
+    handle_state() = default;
+    handle_state(double score, const node_type& v, const t_handle& h) : score(score), v(v), h(h) {}
+
+    bool operator<(const handle_state& s) const {
+        return score != s.score ? score < s.score : v < s.v;
+    }
+};
+
+// splits range r of a node into the ranges of its children
+inline void split(const range_type& r, std::mt19937_64& rng, range_type& left, range_type& right)
+{
+    uint64_t len = r.second - r.first + 1;
+    uint64_t m = r.first + (len > 1 ? rng() % len : 0);
+    left = range_type(r.first, m);
+    right = range_type(m+1, r.second);
+}
+
+uint64_t run_vector(size_t n, size_t expansions, uint64_t seed)
+{
+    std::mt19937_64 rng(seed);
+    std::vector<term_type> terms(n, term_type{1});
+    std::vector<term_type*> t_ptrs;
+    for (auto& t : terms) t_ptrs.push_back(&t);
+    std::priority_queue<vector_state> pq;
+    pq.emplace(1.0, node_type{0,0}, t_ptrs, std::vector<range_type>(n, range_type(0, 1ULL<<40)));
+    uint64_t sink = 0;
+    for (size_t e = 0; e < expansions and !pq.empty(); ++e) {
+        vector_state s = pq.top();
+        pq.pop();
+        std::vector<term_type*> left_t, right_t;
+        std::vector<range_type> left_r, right_r;
+        for (size_t i = 0; i < s.r.size(); ++i) {
+            range_type l, r;
+            split(s.r[i], rng, l, r);
+            left_t.push_back(s.t_ptrs[i]);
+            right_t.push_back(s.t_ptrs[i]);
+            left_r.push_back(l);
+            right_r.push_back(r);
+        }
+        double ls = s.score * (rng() % 1024) / 1024.0;
+        double rs = s.score * (rng() % 1024) / 1024.0;
+        pq.emplace(ls, node_type{s.v.level+1, 2*s.v.sym}, left_t, left_r);
+        pq.emplace(rs, node_type{s.v.level+1, 2*s.v.sym+1}, right_t, right_r);
+        sink += s.r[0].first;
+    }
+    return sink;
+}
+
+template<size_t t_n>
+uint64_t run_fixed(size_t expansions, uint64_t seed)
+{
+    typedef std::array<range_type, t_n> handle_type;
+    typedef handle_state<handle_type> state_type;
+    static thread_local surf::traversal_heap<state_type> pq;
+    std::mt19937_64 rng(seed);
+    pq.clear();
+    handle_type root;
+    root.fill(range_type(0, 1ULL<<40));
+    pq.emplace(1.0, node_type{0,0}, root);
+    uint64_t sink = 0;
+    for (size_t e = 0; e < expansions and !pq.empty(); ++e) {
+        state_type s = pq.pop();
+        handle_type left, right;
+        for (size_t i = 0; i < t_n; ++i) {
+            split(s.h[i], rng, left[i], right[i]);
+        }
+        double ls = s.score * (rng() % 1024) / 1024.0;
+        double rs = s.score * (rng() % 1024) / 1024.0;
+        pq.emplace(ls, node_type{s.v.level+1, 2*s.v.sym}, left);
+        pq.emplace(rs, node_type{s.v.level+1, 2*s.v.sym+1}, right);
+        sink += s.h[0].first;
+    }
+    return sink;
+}
+
+uint64_t run_arena(size_t n, size_t expansions, uint64_t seed)
+{
+    typedef handle_state<uint64_t> state_type;
+    static thread_local surf::traversal_heap<state_type> pq;
+    static thread_local surf::search_arena<range_type> arena;
+    std::mt19937_64 rng(seed);
+    pq.clear();
+    arena.clear();
+    uint64_t h = arena.alloc(n);
+    std::fill(arena.at(h), arena.at(h)+n, range_type(0, 1ULL<<40));
+    pq.emplace(1.0, node_type{0,0}, h);
+    uint64_t sink = 0;
+    for (size_t e = 0; e < expansions and !pq.empty(); ++e) {
+        state_type s = pq.pop();
+        uint64_t lh = arena.alloc(n), rh = arena.alloc(n);
+        for (size_t i = 0; i < n; ++i) {
+            split(arena.at(s.h)[i], rng, arena.at(lh)[i], arena.at(rh)[i]);
+        }
+        sink += arena.at(s.h)[0].first;
+        arena.release(s.h, n);
+        double ls = s.score * (rng() % 1024) / 1024.0;
+        double rs = s.score * (rng() % 1024) / 1024.0;
+        pq.emplace(ls, node_type{s.v.level+1, 2*s.v.sym}, lh);
+        pq.emplace(rs, node_type{s.v.level+1, 2*s.v.sym+1}, rh);
+    }
+    return sink;
+}
+
+uint64_t run_states(size_t n, size_t expansions, uint64_t seed)
+{
+    switch (n) {
+        case 1: return run_fixed<1>(expansions, seed);
+        case 2: return run_fixed<2>(expansions, seed);
+        case 3: return run_fixed<3>(expansions, seed);
+        case 4: return run_fixed<4>(expansions, seed);
+        case 5: return run_fixed<5>(expansions, seed);
+        case 6: return run_fixed<6>(expansions, seed);
+    }
+    return run_arena(n, expansions, seed);
+}
+
+int main(int argc,char* const argv[])
+{
+    typedef std::chrono::high_resolution_clock clock;
+    cmdargs_t args = parse_args(argc,argv);
+    uint64_t sink = 0;
+    std::cout << "terms;expansions;vector_ns_per_expansion;wt_search_ns_per_expansion;speedup" << std::endl;
+    for (size_t n = 1; n <= args.max_terms; ++n) {
+        // warm up the buffers which wt_search keeps between queries
+        sink += run_states(n, args.expansions, 0);
+        auto start = clock::now();
+        for (size_t q = 0; q < args.queries; ++q) {
+            sink += run_vector(n, args.expansions, q);
+        }
+        double t_vector = std::chrono::duration<double, std::nano>(clock::now()-start).count();
+        start = clock::now();
+        for (size_t q = 0; q < args.queries; ++q) {
+            sink += run_states(n, args.expansions, q);
+        }
+        double t_states = std::chrono::duration<double, std::nano>(clock::now()-start).count();
+        double per = (double)args.queries * args.expansions;
+        std::cout << n << ";" << args.expansions << ";"
+                  << std::fixed << std::setprecision(1) << t_vector/per << ";" << t_states/per << ";"
+                  << std::setprecision(2) << t_vector/t_states << std::endl;
+    }
+    std::cerr << "sink=" << sink << std::endl;
+}
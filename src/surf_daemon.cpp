@@ -22,16 +22,18 @@ typedef struct cmdargs {
     std::string collection_dir;
     std::string port;
     bool load_dictionary;
+    uint64_t search_threads;
 } cmdargs_t;
 
 void
 print_usage(char* program)
 {
-    fprintf(stdout,"%s -c <collection directory> -p <port> -r\n",program);
+    fprintf(stdout,"%s -c <collection directory> -p <port> -r -t <threads>\n",program);
     fprintf(stdout,"where\n");
     fprintf(stdout,"  -c <collection directory>  : the directory the collection is stored.\n");
     fprintf(stdout,"  -p <port>  : the port the daemon is running on.\n");
     fprintf(stdout,"  -r : do not load the dictionary.\n");
+    fprintf(stdout,"  -t <threads>  : number of threads used within a query, if supported by the index (default 1).\n");
 };
 
 cmdargs_t
@@ -42,7 +44,8 @@ parse_args(int argc,char* const argv[])
     args.collection_dir = "";
     args.port = std::to_string(12345);
     args.load_dictionary = true;
-    while ((op=getopt(argc,argv,"c:p:r")) != -1) {
+    args.search_threads = 1;
+    while ((op=getopt(argc,argv,"c:p:rt:")) != -1) {
         switch (op) {
             case 'c':
                 args.collection_dir = optarg;
@@ -53,6 +56,9 @@ parse_args(int argc,char* const argv[])
             case 'r':
                 args.load_dictionary = false;
                 break;
+            case 't':
+                args.search_threads = std::strtoul(optarg,NULL,10);
+                break;
             case '?':
             default:
                 print_usage(argv[0]);
@@ -98,6 +104,9 @@ int main(int argc,char* const argv[])
     auto load_stop = clock::now();
     auto load_time_sec = std::chrono::duration_cast<std::chrono::seconds>(load_stop-load_start);
     std::cout << "Index loaded in " << load_time_sec.count() << " seconds." << std::endl;
+    if(args.search_threads > 1 && !surf::set_search_threads(index,args.search_threads)) {
+        std::cout << "Index does not support parallel query processing. Using one thread per query." << std::endl;
+    }
 
 
     /* daemon mode */
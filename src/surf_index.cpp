@@ -2,19 +2,24 @@
 #include "sdsl/config.hpp"
 #include "surf/indexes.hpp"
 #include "surf/util.hpp"
+#include "surf/ram_budget.hpp"
 
 typedef struct cmdargs {
     std::string collection_dir;
     bool print_memusage;
+    uint64_t ram_budget;
+    bool store_direct_cost;
 } cmdargs_t;
 
 void
 print_usage(char* program)
 {
-    fprintf(stdout,"%s -c <collection directory> -m\n",program);
+    fprintf(stdout,"%s -c <collection directory> -m -M <bytes> -d\n",program);
     fprintf(stdout,"where\n");
     fprintf(stdout,"  -c <collection directory>  : the directory the collection is stored.\n");
     fprintf(stdout,"  -m : print memory usage.\n");
+    fprintf(stdout,"  -M <bytes> : RAM budget of the construction steps (default: no limit).\n");
+    fprintf(stdout,"  -d : store the cost model of the direct evaluation, instead of calibrating it at each load.\n");
 };
 
 cmdargs_t
@@ -24,7 +29,9 @@ parse_args(int argc,char* const argv[])
     int op;
     args.collection_dir = "";
     args.print_memusage = false;
-    while ((op=getopt(argc,argv,"c:m")) != -1) {
+    args.ram_budget = 0;
+    args.store_direct_cost = false;
+    while ((op=getopt(argc,argv,"c:mM:d")) != -1) {
         switch (op) {
             case 'c':
                 args.collection_dir = optarg;
@@ -32,6 +39,12 @@ parse_args(int argc,char* const argv[])
             case 'm':
                 args.print_memusage = true;
                 break;
+            case 'M':
+                args.ram_budget = std::strtoull(optarg,NULL,10);
+                break;
+            case 'd':
+                args.store_direct_cost = true;
+                break;
             case '?':
             default:
                 print_usage(argv[0]);
@@ -63,6 +76,10 @@ int main(int argc,char* const argv[])
     std::string index_name = IDXNAME;
 
     /* build the index */
+    surf::construct_ram_budget() = args.ram_budget;
+    if (args.ram_budget) {
+        std::cout<<"RAM budget of the construction: "<<args.ram_budget<<" bytes"<<std::endl;
+    }
     surf_index_t index;
     auto build_start = clock::now();
     construct(index, "", cc, 0);
@@ -72,6 +89,9 @@ int main(int argc,char* const argv[])
 
     /* visualize space usage */
     index.load(cc);
+    if(args.store_direct_cost && !surf::store_direct_cost(index,cc)) {
+        std::cout << "Index has no direct evaluation." << std::endl;
+    }
     std::cout<<"Write structure"<<std::endl;
     std::ofstream vofs(args.collection_dir+"/index/"+surf::SPACEUSAGE_FILENAME+"_"+IDXNAME+".html");
     write_structure<HTML_FORMAT>(index,vofs);
@@ -11,21 +11,27 @@
 #include "sdsl/config.hpp"
 #include "surf/indexes.hpp"
 #include "surf/query_parser.hpp"
+#include "surf/work_stealing_pool.hpp"
+#include <mutex>
 
 typedef struct cmdargs {
     std::string collection_dir;
     std::string query_file;
     uint64_t k;
+    uint64_t threads;
+    uint64_t search_threads;
 } cmdargs_t;
 
 void
 print_usage(char* program)
 {
-    fprintf(stdout,"%s -c <collection directory> -q <query file> -k <top-k> -o <output.csv>\n",program);
+    fprintf(stdout,"%s -c <collection directory> -q <query file> -k <top-k> -t <threads> -p <threads>\n",program);
     fprintf(stdout,"where\n");
     fprintf(stdout,"  -c <collection directory>  : the directory the collection is stored.\n");
     fprintf(stdout,"  -q <query file>  : the queries to be performed.\n");
     fprintf(stdout,"  -k <top-k>  : the top-k documents to be retrieved for each query.\n");
+    fprintf(stdout,"  -t <threads>  : number of queries processed concurrently (default 1).\n");
+    fprintf(stdout,"  -p <threads>  : number of threads used within a query, if supported by the index (default 1).\n");
 };
 
 cmdargs_t
@@ -36,7 +42,9 @@ parse_args(int argc,char* const argv[])
     args.collection_dir = "";
     args.query_file = "";
     args.k = 10;
-    while ((op=getopt(argc,argv,"c:q:k:")) != -1) {
+    args.threads = 1;
+    args.search_threads = 1;
+    while ((op=getopt(argc,argv,"c:q:k:t:p:")) != -1) {
         switch (op) {
             case 'c':
                 args.collection_dir = optarg;
@@ -47,6 +55,12 @@ parse_args(int argc,char* const argv[])
             case 'k':
                 args.k = std::strtoul(optarg,NULL,10);
                 break;
+            case 't':
+                args.threads = std::strtoul(optarg,NULL,10);
+                break;
+            case 'p':
+                args.search_threads = std::strtoul(optarg,NULL,10);
+                break;
             case '?':
             default:
                 print_usage(argv[0]);
@@ -86,18 +100,32 @@ int main(int argc,char* const argv[])
     auto load_stop = clock::now();
     auto load_time_sec = std::chrono::duration_cast<std::chrono::seconds>(load_stop-load_start);
     std::cout << "Index loaded in " << load_time_sec.count() << " seconds." << std::endl;
+    if(args.search_threads > 1 && !surf::set_search_threads(index,args.search_threads)) {
+        std::cout << "Index does not support parallel query processing. Using one thread per query." << std::endl;
+    }
 
     /* process the queries */
     std::map<uint64_t,std::chrono::microseconds> query_times;
     std::map<uint64_t,surf::result> query_results;
     std::map<uint64_t,uint64_t> query_lengths;
 
+    /* each thread records into its own buffers which are merged afterwards */
+    struct thread_buffer {
+        std::map<uint64_t,std::chrono::microseconds> query_times;
+        std::map<uint64_t,surf::result> query_results;
+        std::map<uint64_t,uint64_t> query_lengths;
+    };
+    std::vector<thread_buffer> buffers(std::max(args.threads,(uint64_t)1));
+    std::mutex out_mtx;
+
     size_t num_runs = 1;
-    for(size_t i=0;i<num_runs;i++) {
-        for(const auto& query: queries) {
+    surf::work_stealing_pool::run(num_runs*queries.size(), args.threads,
+        [&](size_t task, size_t tid) {
+            size_t i = task / queries.size();
+            const auto& query = queries[task % queries.size()];
+            auto& buf = buffers[tid];
             auto id = std::get<0>(query);
             auto qry_tokens = std::get<1>(query);
-            std::cout << "[" << id << "] |Q|=" << qry_tokens.size(); std::cout.flush();
 
             // run the query
             auto qry_start = clock::now();
@@ -105,22 +133,41 @@ int main(int argc,char* const argv[])
             auto qry_stop = clock::now();
 
             auto query_time = std::chrono::duration_cast<std::chrono::microseconds>(qry_stop-qry_start);
-            std::cout << " TIME = " << std::setprecision(5)
-                      << query_time.count() / 1000.0 
-                      << " ms" << std::endl;
+            {
+                std::lock_guard<std::mutex> lock(out_mtx);
+                std::cout << "[" << id << "] |Q|=" << qry_tokens.size()
+                          << " TIME = " << std::setprecision(5)
+                          << query_time.count() / 1000.0 
+                          << " ms" << std::endl;
+            }
 
-            auto itr = query_times.find(id);
-            if(itr != query_times.end()) {
+            auto itr = buf.query_times.find(id);
+            if(itr != buf.query_times.end()) {
                 itr->second += query_time;
             } else {
-                query_times[id] = query_time;
+                buf.query_times[id] = query_time;
             }
 
             if(i==0) {
-                query_results[id] = results;
-                query_lengths[id] = qry_tokens.size();
+                buf.query_results[id] = results;
+                buf.query_lengths[id] = qry_tokens.size();
+            }
+        });
+
+    for(auto& buf : buffers) {
+        for(const auto& timing : buf.query_times) {
+            auto itr = query_times.find(timing.first);
+            if(itr != query_times.end()) {
+                itr->second += timing.second;
+            } else {
+                query_times[timing.first] = timing.second;
             }
         }
+        query_results.insert(buf.query_results.begin(),buf.query_results.end());
+        query_lengths.insert(buf.query_lengths.begin(),buf.query_lengths.end());
+    }
+    if(auto tc = surf::get_term_cache(index)) {
+        std::cout << *tc << std::endl;
     }
 
     /* output results to csv */
@@ -0,0 +1,77 @@
+#include <vector>
+#include <random>
+#include <iostream>
+#include <cstdlib>
+#include <string>
+#include <unistd.h>
+
+#include "sdsl/int_vector.hpp"
+#include "surf/df_sada.hpp"
+
+// H and the duplicates of df_sada have to be the same for any number of
+// threads, as construct_h passes the pieces to the output in order.
+int main( int argc, char** argv ) {
+    using df_type = surf::df_sada<>;
+    std::mt19937_64 rng(4711);
+    size_t errors = 0;
+
+    char dir[] = "/tmp/surf_test_df_sada_XXXXXX";
+    if(mkdtemp(dir) == nullptr) {
+        perror("cannot create temporary directory");
+        return EXIT_FAILURE;
+    }
+    sdsl::cache_config cc(false,std::string(dir)+"/","SURF");
+
+    // a small collection of documents over a skewed alphabet, so that
+    // the root has many children and the terms repeat across documents
+    {
+        std::vector<uint64_t> text;
+        size_t num_docs = 200;
+        for(size_t d=0;d<num_docs;d++) {
+            size_t len = 1 + rng()%100;
+            for(size_t j=0;j<len;j++) {
+                text.push_back(2 + (rng()%50)*(rng()%50)/50);
+            }
+            text.push_back(1);
+        }
+        text.push_back(0);
+        sdsl::int_vector<> iv(text.size());
+        std::copy(text.begin(), text.end(), iv.begin());
+        sdsl::util::bit_compress(iv);
+        store_to_cache(iv, sdsl::conf::KEY_TEXT_INT, cc);
+    }
+    df_type df;
+    construct(df, "", cc, 0);
+
+    sdsl::bit_vector expected_h;
+    sdsl::int_vector<> expected_dup;
+    for(size_t threads : {1, 2, 3, 8}) {
+        sdsl::remove(cache_file_name(surf::KEY_H, cc));
+        df_type tmp(cc, threads);
+        sdsl::bit_vector h;
+        sdsl::int_vector<> dup;
+        load_from_cache(h, surf::KEY_H, cc);
+        load_from_cache(dup, surf::KEY_TMPDUP, cc);
+        if(threads == 1) {
+            expected_h = h;
+            expected_dup = dup;
+            continue;
+        }
+        if(h != expected_h) {
+            std::cerr << "ERROR: H differs for " << threads << " threads" << std::endl;
+            errors++;
+        }
+        if(dup != expected_dup) {
+            std::cerr << "ERROR: TMPDUP differs for " << threads << " threads" << std::endl;
+            errors++;
+        }
+    }
+
+    // the construction leaves files which are not registered in cc
+    std::system((std::string("rm -rf ")+dir).c_str());
+    if(errors) {
+        std::cerr << errors << " errors" << std::endl;
+        return EXIT_FAILURE;
+    }
+    std::cout << "OK" << std::endl;
+}
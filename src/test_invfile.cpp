@@ -0,0 +1,110 @@
+#include <vector>
+#include <random>
+#include <iostream>
+#include <algorithm>
+
+#include "surf/idx_invfile.hpp"
+
+// Ranker with integer scores, so that the upper bounds of WAND are exact
+// and many documents tie.
+struct int_ranker {
+    std::vector<uint64_t> doc_lengths;
+
+    double doc_length(size_t doc_id) const {
+        return doc_lengths[doc_id];
+    }
+    double calc_doc_weight(double) const {
+        return 0;
+    }
+    double calculate_docscore(const double f_qt,const double f_dt,const double,
+                              const double,double W_d,bool) const {
+        return f_qt * f_dt * W_d;
+    }
+};
+
+using plist_type = surf::block_postings_list<128>;
+using wand_type = surf::idx_invfile<plist_type,int_ranker,false,false>;
+using bmw_type = surf::idx_invfile<plist_type,int_ranker,false,true>;
+using exhaustive_type = surf::idx_invfile<plist_type,int_ranker,true,false>;
+
+bool same(const surf::result& a, const surf::result& b) {
+    if(a.list.size() != b.list.size()) return false;
+    for(size_t i=0;i<a.list.size();i++) {
+        if(a.list[i].doc_id != b.list[i].doc_id || a.list[i].score != b.list[i].score) return false;
+    }
+    return true;
+}
+
+void print(const char* name, const surf::result& res) {
+    std::cerr << name << ":";
+    for(const auto& x : res.list) {
+        std::cerr << " (" << x.doc_id << "," << x.score << ")";
+    }
+    std::cerr << std::endl;
+}
+
+int main( int argc, char** argv ) {
+    std::mt19937_64 rng(4711);
+    size_t errors = 0;
+
+    // WAND and Block-Max WAND have to return the same documents in the
+    // same order as the exhaustive evaluation, for OR and ranked AND
+    for(size_t i=0;i<200;i++) {
+        size_t num_docs = 2 + rng()%3000;
+        size_t num_terms = 1 + rng()%5;
+        int_ranker ranker;
+        for(size_t d=0;d<num_docs;d++) {
+            ranker.doc_lengths.push_back(1 + rng()%3);
+        }
+        std::vector<plist_type> lists;
+        sdsl::int_vector<> F_t(num_terms);
+        for(size_t t=0;t<num_terms;t++) {
+            // lists of a few postings up to many blocks
+            size_t density = 1 + rng()%64;
+            std::vector< std::pair<uint64_t,uint64_t> > A;
+            for(size_t d=0;d<num_docs;d++) {
+                if(rng()%density == 0) {
+                    A.emplace_back(d, 1 + rng()%4);
+                }
+            }
+            if(A.empty()) {
+                A.emplace_back(rng()%num_docs, 1);
+            }
+            F_t[t] = 0;
+            for(const auto& p : A) F_t[t] = F_t[t] + p.second;
+            lists.emplace_back(ranker,A);
+        }
+        sdsl::int_vector<> id_mapping(num_docs);
+        for(size_t d=0;d<num_docs;d++) {
+            id_mapping[d] = d;
+        }
+        wand_type wand(lists,F_t,id_mapping,ranker);
+        bmw_type bmw(lists,F_t,id_mapping,ranker);
+        exhaustive_type exhaustive(lists,F_t,id_mapping,ranker);
+
+        std::vector<surf::query_token> qry;
+        for(size_t t=0;t<num_terms;t++) {
+            qry.emplace_back(std::vector<uint64_t>(1,t),std::vector<std::string>(1,std::to_string(t)),1);
+        }
+        for(bool ranked_and : {false, true}) {
+            for(size_t k : {0, 1, 2, 3, 10, 100}) {
+                auto expected = exhaustive.search(qry,k,ranked_and);
+                auto res_wand = wand.search(qry,k,ranked_and);
+                auto res_bmw = bmw.search(qry,k,ranked_and);
+                if(!same(res_wand, expected) || !same(res_bmw, expected)) {
+                    std::cerr << "ERROR: WAND differs from exhaustive evaluation (k=" << k
+                              << ", ranked_and=" << ranked_and << ", terms=" << num_terms << ")" << std::endl;
+                    print("exhaustive", expected);
+                    print("wand", res_wand);
+                    print("bmw", res_bmw);
+                    errors++;
+                }
+            }
+        }
+    }
+    if(errors) {
+        std::cerr << errors << " errors" << std::endl;
+        return EXIT_FAILURE;
+    }
+    std::cout << "OK" << std::endl;
+}
@@ -1,9 +1,28 @@
 
 #include <vector>
+#include <sstream>
+#include <limits>
 #include <iostream>
+#include <algorithm>
 
 #include "surf/block_postings_list.hpp"
 
+// Ranker with a doc weight, so that the block maxima of both differ.
+struct block_ranker {
+    std::vector<uint64_t> doc_lengths;
+
+    double doc_length(size_t doc_id) const {
+        return doc_lengths[doc_id];
+    }
+    double calc_doc_weight(double W_d) const {
+        return -W_d;
+    }
+    double calculate_docscore(const double f_qt,const double f_dt,const double,
+                              const double,double W_d,bool) const {
+        return f_qt * f_dt / W_d;
+    }
+};
+
 int main( int argc, char** argv ) {
     using plist_type = surf::block_postings_list<128>;
 
@@ -59,6 +78,70 @@ int main( int argc, char** argv ) {
         }
     }
 
-}
-
+    // test the block maxima of lists shorter than, equal to and longer
+    // than a block, before and after a serialization round trip
+    size_t errors = 0;
+    block_ranker ranker;
+    for(size_t d=0;d<100000;d++) {
+        ranker.doc_lengths.push_back(1 + rand()%1000);
+    }
+    for(size_t n : {1, 50, 127, 128, 129, 256, 300, 1000}) {
+        std::vector< std::pair<uint64_t,uint64_t> > A;
+        uint64_t cur_id = rand()%50;
+        for(size_t j=0;j<n;j++) {
+            cur_id += 1 + rand()%50;
+            uint64_t cur_freq = 1 + rand() % 50;
+            A.emplace_back(cur_id,cur_freq);
+        }
+        size_t num_blocks = (n + 127) / 128;
+        std::vector<double> max_score(num_blocks,std::numeric_limits<double>::lowest());
+        std::vector<double> max_doc_weight(num_blocks,std::numeric_limits<double>::lowest());
+        for(size_t j=0;j<n;j++) {
+            double W_d = ranker.doc_length(A[j].first);
+            max_score[j/128] = std::max(max_score[j/128],
+                                        ranker.calculate_docscore(1.0,A[j].second,n,0,W_d,true));
+            max_doc_weight[j/128] = std::max(max_doc_weight[j/128],ranker.calc_doc_weight(W_d));
+        }
+        plist_type pl(ranker,A);
+        std::stringstream ss;
+        pl.serialize(ss);
+        plist_type loaded(ss);
 
+        for(const auto* l : {&pl, &loaded}) {
+            const char* name = l == &pl ? "built" : "loaded";
+            if(l->num_blocks() != num_blocks) {
+                std::cerr << "ERROR: " << name << " list of size " << n << " has "
+                          << l->num_blocks() << " blocks instead of " << num_blocks << std::endl;
+                errors++;
+                continue;
+            }
+            for(size_t b=0;b<num_blocks;b++) {
+                if(l->block_max_score(b) != max_score[b] ||
+                   l->block_max_doc_weight(b) != max_doc_weight[b]) {
+                    std::cerr << "ERROR: block max of block " << b << " of " << name
+                              << " list of size " << n << std::endl;
+                    errors++;
+                }
+            }
+            if(l->list_max_score() != *std::max_element(max_score.begin(),max_score.end()) ||
+               l->max_doc_weight() != *std::max_element(max_doc_weight.begin(),max_doc_weight.end())) {
+                std::cerr << "ERROR: list max of " << name << " list of size " << n << std::endl;
+                errors++;
+            }
+            size_t j=0;
+            for(auto itr = l->begin(); itr != l->end(); ++itr, ++j) {
+                if(itr.docid() != A[j].first || itr.freq() != A[j].second) {
+                    std::cerr << "ERROR: posting " << j << " of " << name
+                              << " list of size " << n << std::endl;
+                    errors++;
+                    break;
+                }
+            }
+        }
+    }
+    if(errors) {
+        std::cerr << errors << " errors" << std::endl;
+        return EXIT_FAILURE;
+    }
+    std::cout << "OK" << std::endl;
+}
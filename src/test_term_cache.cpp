@@ -0,0 +1,166 @@
+#include <vector>
+#include <map>
+#include <tuple>
+#include <iostream>
+
+#include "surf/term_cache.hpp"
+
+// CSA which knows the intervals of a few tokens and counts its searches.
+struct mock_csa {
+    std::map<std::vector<uint64_t>, std::pair<uint64_t,uint64_t>> intervals;
+    mutable size_t searches = 0;
+
+    uint64_t size() const {
+        return 1000;
+    }
+};
+
+template<class t_itr>
+uint64_t backward_search(const mock_csa& csa, uint64_t, uint64_t, t_itr begin, t_itr end,
+                         uint64_t& sp, uint64_t& ep) {
+    ++csa.searches;
+    auto itr = csa.intervals.find(std::vector<uint64_t>(begin, end));
+    if(itr == csa.intervals.end()) {
+        return 0;
+    }
+    sp = itr->second.first;
+    ep = itr->second.second;
+    return ep-sp+1;
+}
+
+struct mock_df {
+    mutable size_t calls = 0;
+
+    std::tuple<uint64_t,uint64_t,uint64_t> operator()(uint64_t sp, uint64_t ep) const {
+        ++calls;
+        return std::make_tuple(ep-sp+1, 2*sp, 2*ep);
+    }
+};
+
+size_t errors = 0;
+
+void check(bool ok, const char* what) {
+    if(!ok) {
+        std::cerr << "ERROR: " << what << std::endl;
+        errors++;
+    }
+}
+
+int main( int argc, char** argv ) {
+    mock_csa csa;
+    for(uint64_t t=0;t<10;t++) {
+        csa.intervals[{t}] = {10*t, 10*t+t};
+    }
+    csa.intervals[{1,2}] = {500, 501};
+    mock_df df;
+    using key = surf::term_cache::key_type;
+
+    // the cached information is the one of the backward search and df
+    {
+        surf::term_cache tc(8);
+        auto info = tc.lookup(csa, df, {1,2});
+        check(info.sp == 500 && info.ep == 501 && info.f_Dt == 2 &&
+              info.dup_sp == 1000 && info.dup_ep == 1002, "information of a phrase");
+        size_t searches = csa.searches;
+        auto cached = tc.lookup(csa, df, {1,2});
+        check(csa.searches == searches, "phrase is not cached");
+        check(cached.sp == info.sp && cached.ep == info.ep && cached.f_Dt == info.f_Dt &&
+              cached.dup_sp == info.dup_sp && cached.dup_ep == info.dup_ep, "cached information differs");
+    }
+
+    // the least recently used token is evicted, a hit counts as a use
+    {
+        surf::term_cache tc(3);
+        tc.lookup(csa, df, {1});
+        tc.lookup(csa, df, {2});
+        tc.lookup(csa, df, {3});
+        tc.lookup(csa, df, {1});  // order 1,3,2
+        tc.lookup(csa, df, {4});  // evicts 2, order 4,1,3
+        size_t searches = csa.searches;
+        tc.lookup(csa, df, {1});
+        tc.lookup(csa, df, {3});
+        tc.lookup(csa, df, {4});
+        check(csa.searches == searches, "LRU evicted a recently used token");
+        tc.lookup(csa, df, {2});  // evicts 1, order 2,4,3
+        check(csa.searches == searches+1, "LRU kept the least recently used token");
+        tc.lookup(csa, df, {1});  // evicts 3, order 1,2,4
+        check(csa.searches == searches+2, "LRU evicted the wrong token");
+        tc.lookup(csa, df, {2});
+        tc.lookup(csa, df, {4});
+        check(csa.searches == searches+2, "LRU evicted the wrong token");
+        tc.lookup(csa, df, {3});
+        check(csa.searches == searches+3, "LRU evicted the wrong token");
+    }
+
+    // shrinking keeps the most recently used tokens
+    {
+        surf::term_cache tc(4);
+        for(uint64_t t : {1, 2, 3, 4}) {
+            tc.lookup(csa, df, {t});
+        }
+        tc.set_capacity(2);
+        check(tc.capacity() == 2, "capacity after shrinking");
+        size_t searches = csa.searches;
+        tc.lookup(csa, df, {4});
+        tc.lookup(csa, df, {3});
+        check(csa.searches == searches, "shrinking evicted a recently used token");
+        tc.lookup(csa, df, {1});
+        tc.lookup(csa, df, {2});
+        check(csa.searches == searches+2, "shrinking kept the least recently used tokens");
+        tc.set_capacity(0);
+        tc.set_capacity(2);
+        tc.lookup(csa, df, {2});
+        check(csa.searches == searches+3, "shrinking to 0 kept tokens");
+    }
+
+    // a capacity of 0 bypasses the cache
+    {
+        surf::term_cache tc(0);
+        size_t searches = csa.searches;
+        for(size_t i=0;i<3;i++) {
+            auto info = tc.lookup(csa, df, {5});
+            check(info.sp == 50 && info.ep == 55, "information without cache");
+        }
+        tc.insert({6}, surf::term_range_info());
+        tc.lookup(csa, df, {6});
+        check(csa.searches == searches+4, "capacity 0 cached a token");
+        check(tc.hits() == 0 && tc.misses() == 4, "counters without cache");
+    }
+
+    // tokens which do not occur are cached, without a df lookup
+    {
+        surf::term_cache tc(4);
+        size_t searches = csa.searches;
+        size_t calls = df.calls;
+        auto info = tc.lookup(csa, df, {42});
+        check(info.empty() && info.f_Dt == 0, "absent token is not empty");
+        auto cached = tc.lookup(csa, df, {42});
+        check(cached.empty() && cached.f_Dt == 0, "cached absent token is not empty");
+        check(csa.searches == searches+1, "absent token is not cached");
+        check(df.calls == calls, "df lookup of an absent token");
+        check(tc.hits() == 1 && tc.misses() == 1, "counters of an absent token");
+    }
+
+    // hits, misses and the hit rate; clear resets them
+    {
+        surf::term_cache tc(2);
+        check(tc.hit_rate() == 0.0, "hit rate of an unused cache");
+        for(uint64_t t : {1, 2, 1, 2, 3, 1}) {
+            tc.lookup(csa, df, key{t});
+        }
+        // 1 and 2 are misses, then hits; 3 evicts 1, so 1 misses again
+        check(tc.hits() == 2 && tc.misses() == 4, "hit and miss counters");
+        check(tc.hit_rate() == 2.0/6, "hit rate");
+        tc.clear();
+        check(tc.hits() == 0 && tc.misses() == 0, "counters after clear");
+        size_t searches = csa.searches;
+        tc.lookup(csa, df, {1});
+        check(csa.searches == searches+1, "clear kept tokens");
+    }
+
+    if(errors) {
+        std::cerr << errors << " errors" << std::endl;
+        return EXIT_FAILURE;
+    }
+    std::cout << "OK" << std::endl;
+}
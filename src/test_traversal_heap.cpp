@@ -0,0 +1,103 @@
+#include <vector>
+#include <random>
+#include <queue>
+#include <iostream>
+
+#include "surf/traversal_heap.hpp"
+
+// State with few distinct scores, so that the order of ties matters, and
+// a payload which has to move with the state when its slot is reused.
+struct state_type {
+    double score;
+    uint64_t level;
+    uint64_t sym;
+    std::vector<uint64_t> payload;
+
+    state_type() = default;
+    state_type(double score, uint64_t level, uint64_t sym, const std::vector<uint64_t>& payload)
+        : score(score), level(level), sym(sym), payload(payload) {}
+
+    bool operator<(const state_type& s) const {
+        if(score != s.score) return score < s.score;
+        return level != s.level ? level < s.level : sym < s.sym;
+    }
+};
+
+bool same(const state_type& a, const state_type& b) {
+    return a.score == b.score && a.level == b.level && a.sym == b.sym && a.payload == b.payload;
+}
+
+// pops of the traversal_heap have to return the same states in the same
+// order as a std::priority_queue, under random pushes, pops and clears
+template<uint32_t t_arity>
+size_t check_heap(uint64_t seed) {
+    std::mt19937_64 rng(seed);
+    surf::traversal_heap<state_type,t_arity> heap;
+    std::priority_queue<state_type> pq;
+    size_t errors = 0;
+    uint64_t next_sym = 0;
+    for(size_t i=0;i<200000 && errors < 10;i++) {
+        uint64_t op = rng()%1000;
+        if(op < 550) {
+            std::vector<uint64_t> payload(rng()%4, next_sym);
+            state_type s((double)(rng()%8), rng()%4, next_sym++, payload);
+            pq.push(s);
+            heap.emplace(s.score, s.level, s.sym, s.payload);
+        } else if(op < 999) {
+            if(heap.empty() != pq.empty() || heap.size() != pq.size()) {
+                std::cerr << "ERROR: size " << heap.size() << " instead of " << pq.size()
+                          << " (arity " << t_arity << ")" << std::endl;
+                errors++;
+                break;
+            }
+            if(pq.empty()) continue;
+            if(!same(heap.top(), pq.top())) {
+                std::cerr << "ERROR: top differs (arity " << t_arity << ")" << std::endl;
+                errors++;
+            }
+            state_type s = heap.pop();
+            if(!same(s, pq.top())) {
+                std::cerr << "ERROR: pop returned (" << s.score << "," << s.level << "," << s.sym
+                          << ") instead of (" << pq.top().score << "," << pq.top().level << ","
+                          << pq.top().sym << ") (arity " << t_arity << ")" << std::endl;
+                errors++;
+            }
+            pq.pop();
+        } else {
+            heap.clear();
+            pq = std::priority_queue<state_type>();
+        }
+    }
+    // drain the rest
+    while(!pq.empty() && errors < 10) {
+        if(heap.empty()) {
+            std::cerr << "ERROR: heap empty before priority_queue (arity " << t_arity << ")" << std::endl;
+            errors++;
+            break;
+        }
+        if(!same(heap.pop(), pq.top())) {
+            std::cerr << "ERROR: pop differs while draining (arity " << t_arity << ")" << std::endl;
+            errors++;
+        }
+        pq.pop();
+    }
+    if(!heap.empty()) {
+        std::cerr << "ERROR: heap not empty after draining (arity " << t_arity << ")" << std::endl;
+        errors++;
+    }
+    return errors;
+}
+
+int main( int argc, char** argv ) {
+    size_t errors = 0;
+    for(uint64_t seed=0;seed<5;seed++) {
+        errors += check_heap<2>(seed);
+        errors += check_heap<4>(seed);
+        errors += check_heap<8>(seed);
+    }
+    if(errors) {
+        std::cerr << errors << " errors" << std::endl;
+        return EXIT_FAILURE;
+    }
+    std::cout << "OK" << std::endl;
+}
@@ -0,0 +1,146 @@
+#include <vector>
+#include <random>
+#include <iostream>
+#include <algorithm>
+
+#include "sdsl/wavelet_trees.hpp"
+#include "surf/idx_d.hpp"
+#include "surf/wt_search.hpp"
+
+// Ranker with few distinct scores, so that many documents tie. The
+// document length is the smallest one of the node for inner nodes, which
+// keeps the scores of inner nodes upper bounds.
+struct tie_ranker {
+    std::vector<uint64_t> doc_lengths;
+
+    double doc_length(size_t doc_id) const {
+        return doc_lengths[doc_id];
+    }
+    double calc_doc_weight(double) const {
+        return 0;
+    }
+    double calculate_docscore(const double f_qt,const double f_dt,const double,
+                              const double,double W_d,bool) const {
+        return f_qt * f_dt / W_d;
+    }
+};
+
+bool same(const surf::result& a, const surf::result& b) {
+    if(a.list.size() != b.list.size()) return false;
+    for(size_t i=0;i<a.list.size();i++) {
+        if(a.list[i].doc_id != b.list[i].doc_id || a.list[i].score != b.list[i].score) return false;
+    }
+    return true;
+}
+
+void print(const char* name, const surf::result& res) {
+    std::cerr << name << ":";
+    for(const auto& x : res.list) {
+        std::cerr << " (" << x.doc_id << "," << x.score << ")";
+    }
+    std::cerr << std::endl;
+}
+
+int main( int argc, char** argv ) {
+    using wt_type = sdsl::wt_int<>;
+    std::mt19937_64 rng(4711);
+    size_t errors = 0;
+
+    // four documents of equal score: the top-2 are the ones with the
+    // highest length order ids, in both evaluations
+    {
+        surf::doc_perm docperm;
+        docperm.id2len = sdsl::int_vector<>(4);
+        docperm.len2id = sdsl::int_vector<>(4);
+        tie_ranker ranker;
+        for(size_t d=0;d<4;d++) {
+            docperm.id2len[d] = docperm.len2id[d] = d;
+            ranker.doc_lengths.push_back(1);
+        }
+        sdsl::int_vector<> iv = {2, 0, 3, 1};
+        wt_type wtd;
+        sdsl::construct_im(wtd, iv, 0);
+        std::vector<surf::term_info> terms;
+        terms.emplace_back(std::vector<uint64_t>(1,0), 1, 0, 3, 4);
+        std::vector<sdsl::range_type> v_ranges = {{0, 3}};
+        surf::no_wt wtr;
+        auto tf = [](size_t, const wt_type::node_type&, const surf::wt_term_ranges& r){
+            return sdsl::size(r.v);
+        };
+        auto search = surf::make_wt_search(wtd, wtr, docperm, ranker, terms, tf);
+        surf::result expected;
+        expected.list = {{3, 1.0}, {2, 1.0}};
+        auto res = search(v_ranges, {}, 2, false, false);
+        auto res_direct = search.direct(v_ranges, 2, false, false);
+        if(!same(res, expected) || !same(res_direct, expected)) {
+            std::cerr << "ERROR: ties at rank k" << std::endl;
+            print("traversal", res);
+            print("direct", res_direct);
+            errors++;
+        }
+    }
+
+    // the traversal and direct() have to return the same documents in
+    // the same order, also if documents tie with the k-th score
+    for(size_t i=0;i<300;i++) {
+        size_t num_docs = 2 + rng()%60;
+        size_t n = 1 + rng()%4;
+        surf::doc_perm docperm;
+        docperm.id2len = sdsl::int_vector<>(num_docs);
+        docperm.len2id = sdsl::int_vector<>(num_docs);
+        tie_ranker ranker;
+        for(size_t d=0;d<num_docs;d++) {
+            docperm.id2len[d] = docperm.len2id[d] = d;
+            ranker.doc_lengths.push_back(1 + (3*d)/num_docs);
+        }
+        // the ranges of the terms are consecutive in the D array
+        std::vector<uint64_t> D;
+        std::vector<surf::term_info> terms;
+        std::vector<sdsl::range_type> v_ranges;
+        for(size_t t=0;t<n;t++) {
+            size_t occ = 1 + rng()%(2*num_docs);
+            size_t sp = D.size();
+            std::vector<bool> seen(num_docs, false);
+            size_t f_Dt = 0;
+            for(size_t j=0;j<occ;j++) {
+                uint64_t d = rng()%num_docs;
+                f_Dt += !seen[d];
+                seen[d] = true;
+                D.push_back(d);
+            }
+            terms.emplace_back(std::vector<uint64_t>(1,t), 1 + rng()%2, sp, D.size()-1, f_Dt);
+            v_ranges.emplace_back(sp, D.size()-1);
+        }
+        sdsl::int_vector<> iv(D.size());
+        std::copy(D.begin(), D.end(), iv.begin());
+        wt_type wtd;
+        sdsl::construct_im(wtd, iv, 0);
+
+        surf::no_wt wtr;
+        auto tf = [](size_t, const wt_type::node_type&, const surf::wt_term_ranges& r){
+            return sdsl::size(r.v);
+        };
+        auto search = surf::make_wt_search(wtd, wtr, docperm, ranker, terms, tf);
+        for(bool ranked_and : {false, true}) {
+            for(size_t k : {1, 2, 3, 5, 10}) {
+                auto expected = search.direct(v_ranges, k, ranked_and, false);
+                for(bool drop : {false, true}) {
+                    search.set_term_dropping(drop);
+                    auto res = search(v_ranges, {}, k, ranked_and, false);
+                    if(!same(res, expected)) {
+                        std::cerr << "ERROR: traversal differs from direct evaluation (k=" << k
+                                  << ", ranked_and=" << ranked_and << ", drop=" << drop << ")" << std::endl;
+                        print("traversal", res);
+                        print("direct", expected);
+                        errors++;
+                    }
+                }
+            }
+        }
+    }
+    if(errors) {
+        std::cerr << errors << " errors" << std::endl;
+        return EXIT_FAILURE;
+    }
+    std::cout << "OK" << std::endl;
+}